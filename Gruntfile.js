@@ -15,7 +15,7 @@ module.exports = function(grunt) {
 				src: 'Gruntfile.js',
 			},
 			lib: {
-				src: ['index.js']
+				src: ['index.js', 'bin/*.js']
 			},
 			tests: {
 				src: ['test/**/*.js']
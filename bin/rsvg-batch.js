@@ -0,0 +1,519 @@
+#!/usr/bin/env node
+'use strict';
+
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+var childProcess = require('child_process');
+
+var usage = [
+	'Usage: rsvg-batch [options] <input...>',
+	'',
+	'Inputs are SVG files, directories (searched recursively for .svg files) or',
+	'glob patterns like "icons/**/*.svg" (quote them to avoid shell expansion).',
+	'',
+	'Options:',
+	'  -o, --output <dir>     Output directory. Default: next to each input file.',
+	'  -f, --format <list>    Comma separated output formats: png, png8, pdf, svg.',
+	'                         Default: png. The svg format needs --output. Next',
+	'                         to png, png8 images are named like "logo-png8.png".',
+	'  -s, --size <list>      Comma separated output sizes, eg. 64x64,128x128.',
+	'                         Default: the size of the SVG document.',
+	'  -j, --jobs <n>         Number of worker processes. Default: number of CPUs.',
+	'  -F, --force            Render even if the outputs are up to date.',
+	'  -q, --quiet            Only report failures.',
+	'  -h, --help             Show this help.'
+].join('\n');
+
+var extensions = { png: 'png', png8: 'png', pdf: 'pdf', svg: 'svg' };
+
+/**
+ * Parse a size like "64x48" into an object.
+ * @private
+ */
+function parseSize(size) {
+	var match = /^(\d+)x(\d+)$/.exec(size);
+	if (!match || +match[1] <= 0 || +match[2] <= 0) {
+		throw new Error('Invalid size: ' + size);
+	}
+	return { width: +match[1], height: +match[2] };
+}
+
+/**
+ * Parse command line arguments.
+ * @private
+ */
+function parseArgs(argv) {
+	var options = {
+		inputs: [],
+		output: null,
+		formats: ['png'],
+		sizes: [null],
+		jobs: os.cpus().length,
+		force: false,
+		quiet: false
+	};
+
+	function value(i) {
+		if (i >= argv.length) {
+			throw new Error('Missing value for option: ' + argv[i - 1]);
+		}
+		return argv[i];
+	}
+
+	for (var i = 0; i < argv.length; i++) {
+		var arg = argv[i];
+		if (arg === '-o' || arg === '--output') {
+			options.output = value(++i);
+		} else if (arg === '-f' || arg === '--format') {
+			options.formats = value(++i).toLowerCase().split(',');
+		} else if (arg === '-s' || arg === '--size') {
+			options.sizes = value(++i).split(',').map(parseSize);
+		} else if (arg === '-j' || arg === '--jobs') {
+			options.jobs = parseInt(value(++i), 10);
+		} else if (arg === '-F' || arg === '--force') {
+			options.force = true;
+		} else if (arg === '-q' || arg === '--quiet') {
+			options.quiet = true;
+		} else if (arg === '-h' || arg === '--help') {
+			options.help = true;
+		} else if (arg.charAt(0) === '-' && arg.length > 1) {
+			throw new Error('Unknown option: ' + arg);
+		} else {
+			options.inputs.push(arg);
+		}
+	}
+
+	options.formats.forEach(function(format) {
+		if (!extensions.hasOwnProperty(format)) {
+			throw new Error('Invalid format: ' + format);
+		}
+	});
+	if (options.formats.indexOf('svg') !== -1 && !options.output) {
+		throw new Error('The svg format needs an output directory, to keep the inputs.');
+	}
+	if (!(options.jobs > 0)) {
+		throw new Error('Invalid number of jobs.');
+	}
+
+	return options;
+}
+
+/**
+ * Turn a glob pattern (relative to its base directory) into a regular
+ * expression. Supports "**", "*" and "?".
+ * @private
+ */
+function globToRegExp(pattern) {
+	var source = pattern.split(/(\*\*\/?|\*|\?)/).map(function(part) {
+		if (part === '**/' || part === '**') {
+			return '(?:.*/)?' + (part === '**' ? '[^/]*' : '');
+		} else if (part === '*') {
+			return '[^/]*';
+		} else if (part === '?') {
+			return '[^/]';
+		}
+		return part.replace(/[\\^$.+()|{}\[\]]/g, '\\$&');
+	}).join('');
+	return new RegExp('^' + source + '$');
+}
+
+/**
+ * Gives a test whether a directory (relative to the base directory of a glob
+ * pattern) may contain matches, so the walker does not descend into others.
+ * @private
+ */
+function globDirTest(pattern) {
+	var segments = pattern.split('/');
+	var recursive = segments.findIndex(function(segment) {
+		return segment.indexOf('**') !== -1;
+	});
+	var fixed = segments.slice(0, recursive === -1 ? segments.length : recursive)
+		.map(globToRegExp);
+	return function(dir) {
+		var parts = dir.split('/');
+		// Without "**", matches are exactly as deep as the pattern.
+		if (recursive === -1 && parts.length >= segments.length) {
+			return false;
+		}
+		return parts.slice(0, fixed.length).every(function(part, i) {
+			return fixed[i].test(part);
+		});
+	};
+}
+
+/**
+ * Lazily walks the inputs and yields one SVG file at a time, so huge directory
+ * trees are never listed in memory at once.
+ * @private
+ */
+function InputWalker(inputs) {
+	this.roots = inputs.slice();
+	this.dirs = [];
+	this.files = [];
+}
+
+InputWalker.prototype.next = function(callback) {
+	var self = this;
+
+	if (self.files.length) {
+		return callback(null, self.files.shift());
+	}
+
+	if (self.dirs.length) {
+		var dir = self.dirs.shift();
+		return fs.readdir(dir.path, { withFileTypes: true }, function(error, entries) {
+			if (error) {
+				return callback(error);
+			}
+			entries.sort(function(a, b) {
+				return a.name < b.name ? -1 : a.name > b.name ? 1 : 0;
+			}).forEach(function(entry) {
+				var file = path.join(dir.path, entry.name);
+				var relative = path.join(dir.relative, entry.name);
+				var posix = relative.split(path.sep).join('/');
+				var isDirectory = entry.isDirectory();
+				if (entry.isSymbolicLink()) {
+					// Only links need a stat to tell what they point to.
+					try {
+						isDirectory = fs.statSync(file).isDirectory();
+					} catch (e) {
+						return;
+					}
+				}
+				if (isDirectory) {
+					if (!dir.descend || dir.descend(posix)) {
+						self.dirs.push({
+							path: file,
+							relative: relative,
+							match: dir.match,
+							descend: dir.descend
+						});
+					}
+				} else if (dir.match ? dir.match.test(posix) : /\.svg$/i.test(entry.name)) {
+					self.files.push({ path: file, relative: relative });
+				}
+			});
+			self.next(callback);
+		});
+	}
+
+	if (self.roots.length) {
+		var input = self.roots.shift();
+		var wildcard = input.search(/[*?]/);
+		if (wildcard !== -1) {
+			var base = input.slice(0, input.lastIndexOf('/', wildcard) + 1) || '.';
+			var pattern = input.slice(base === '.' ? 0 : base.length);
+			self.dirs.push({
+				path: base,
+				relative: '',
+				match: globToRegExp(pattern),
+				descend: globDirTest(pattern)
+			});
+			return self.next(callback);
+		}
+		return fs.stat(input, function(error, stats) {
+			if (error) {
+				return callback(error);
+			}
+			if (stats.isDirectory()) {
+				self.dirs.push({ path: input, relative: '' });
+			} else {
+				self.files.push({ path: input, relative: path.basename(input) });
+			}
+			self.next(callback);
+		});
+	}
+
+	callback(null, null);
+};
+
+/**
+ * Give back a file, to be returned again by the next call of next().
+ * @private
+ */
+InputWalker.prototype.putBack = function(file) {
+	this.files.unshift(file);
+};
+
+/**
+ * List the output files of one input file.
+ * @private
+ */
+function outputsFor(file, options) {
+	var dir = options.output ?
+		path.join(options.output, path.dirname(file.relative)) :
+		path.dirname(file.path);
+	var name = path.basename(file.path).replace(/\.svg$/i, '');
+	var outputs = [];
+
+	options.formats.forEach(function(format) {
+		// Keep png8 images apart from png images of the same input.
+		var formatSuffix = format !== extensions[format] &&
+			options.formats.indexOf(extensions[format]) !== -1 ? '-' + format : '';
+		options.sizes.forEach(function(size) {
+			var suffix = size && options.sizes.length > 1 ?
+				'-' + size.width + 'x' + size.height : '';
+			outputs.push({
+				path: path.join(dir, name + formatSuffix + suffix + '.' + extensions[format]),
+				format: format,
+				width: size ? size.width : null,
+				height: size ? size.height : null
+			});
+		});
+	});
+
+	return outputs;
+}
+
+/**
+ * Checks whether any output would overwrite the input file, eg. svg outputs in
+ * the input directory.
+ * @private
+ */
+function overwritesInput(file, outputs) {
+	// Compare case insensitive, to be safe on case insensitive file systems.
+	var input = path.resolve(file.path).toLowerCase();
+	return outputs.some(function(output) {
+		return path.resolve(output.path).toLowerCase() === input;
+	});
+}
+
+/**
+ * Checks whether all outputs are newer than the input file.
+ * @private
+ */
+function isUpToDate(file, outputs) {
+	try {
+		var mtime = fs.statSync(file.path).mtime.getTime();
+		return outputs.every(function(output) {
+			return fs.statSync(output.path).mtime.getTime() >= mtime;
+		});
+	} catch (error) {
+		return false;
+	}
+}
+
+/**
+ * Create a directory and its parents.
+ * @private
+ */
+function mkdirp(dir) {
+	if (fs.existsSync(dir)) {
+		return;
+	}
+	mkdirp(path.dirname(dir));
+	try {
+		fs.mkdirSync(dir);
+	} catch (error) {
+		if (error.code !== 'EEXIST') {
+			throw error;
+		}
+	}
+}
+
+/**
+ * Worker process: renders one input file per message.
+ * @private
+ */
+function runWorker() {
+	var Rsvg = require('..').Rsvg;
+
+	process.on('message', function(task) {
+		var result = { input: task.input, rendered: 0, bytes: 0 };
+		try {
+			var svg = new Rsvg(fs.readFileSync(task.input));
+			task.outputs.forEach(function(output) {
+				var image = svg.render({
+					format: output.format,
+					width: output.width || svg.width,
+					height: output.height || svg.height
+				});
+				mkdirp(path.dirname(output.path));
+				fs.writeFileSync(output.path, image.data);
+				result.rendered++;
+				result.bytes += image.data.length;
+			});
+		} catch (error) {
+			result.error = error.message;
+		}
+		process.send(result);
+	});
+}
+
+/**
+ * Master process: walks the inputs and hands them out to the workers.
+ * @private
+ */
+function runMaster(options) {
+	var walker = new InputWalker(options.inputs);
+	var start = process.hrtime();
+	var stats = { files: 0, rendered: 0, skipped: 0, failed: 0, bytes: 0 };
+	var walking = false;
+	var dispatching = false;
+	var redispatch = false;
+	var done = false;
+	var finished = false;
+	var idle = [];
+	var workers = [];
+
+	function log(message) {
+		if (!options.quiet) {
+			console.log(message);
+		}
+	}
+
+	function finish() {
+		var elapsed = process.hrtime(start);
+		var seconds = elapsed[0] + elapsed[1] / 1e9;
+		finished = true;
+		workers.forEach(function(worker) {
+			worker.disconnect();
+		});
+		log(
+			stats.files + ' files, ' + stats.rendered + ' outputs rendered (' +
+			(stats.bytes / 1048576).toFixed(1) + ' MiB), ' + stats.skipped +
+			' up to date, ' + stats.failed + ' failed in ' + seconds.toFixed(1) + 's (' +
+			(stats.files / seconds).toFixed(1) + ' files/s, ' +
+			(stats.rendered / seconds).toFixed(1) + ' outputs/s)'
+		);
+		process.exit(stats.failed ? 1 : 0);
+	}
+
+	function onFile(error, file) {
+		walking = false;
+		if (error) {
+			stats.failed++;
+			console.error('Failed: ' + error.message);
+			return dispatch();
+		}
+		if (!file) {
+			done = true;
+			return dispatch();
+		}
+		if (!idle.length) {
+			// The idle worker exited while walking, wait for another one.
+			walker.putBack(file);
+			return dispatch();
+		}
+
+		stats.files++;
+		var outputs = outputsFor(file, options);
+		if (overwritesInput(file, outputs)) {
+			stats.failed++;
+			console.error('Failed: ' + file.path + ': output would overwrite the input');
+			return dispatch();
+		}
+		if (!options.force && isUpToDate(file, outputs)) {
+			stats.skipped++;
+			return dispatch();
+		}
+
+		var worker = idle.shift();
+		worker.task = { input: file.path, outputs: outputs };
+		worker.send(worker.task);
+		dispatch();
+	}
+
+	function dispatch() {
+		// The walker often calls back synchronously, eg. for each skipped file,
+		// so loop here instead of recursing once per file.
+		if (dispatching) {
+			redispatch = true;
+			return;
+		}
+		dispatching = true;
+		do {
+			redispatch = false;
+			if (walking || done || !idle.length) {
+				if (done && idle.length === workers.length) {
+					finish();
+				}
+				break;
+			}
+			walking = true;
+			walker.next(onFile);
+		} while (redispatch);
+		dispatching = false;
+	}
+
+	function spawn() {
+		var worker = childProcess.fork(__filename, ['--worker']);
+		worker.on('message', onResult.bind(null, worker));
+		worker.on('exit', onExit.bind(null, worker));
+		workers.push(worker);
+		idle.push(worker);
+	}
+
+	function onExit(worker, code, signal) {
+		if (finished) {
+			return;
+		}
+		// A crashing render takes down its worker; count it and start over.
+		workers.splice(workers.indexOf(worker), 1);
+		if (idle.indexOf(worker) !== -1) {
+			idle.splice(idle.indexOf(worker), 1);
+		}
+		if (!worker.task) {
+			// Died without a task, so it can not start at all.
+			if (!workers.length) {
+				console.error('Failed: workers exited (' + (signal || code) + ')');
+				process.exit(1);
+			}
+			return dispatch();
+		}
+		stats.failed++;
+		console.error('Failed: ' + worker.task.input + ': worker exited (' +
+			(signal || code) + ')');
+		spawn();
+		dispatch();
+	}
+
+	function onResult(worker, result) {
+		worker.task = null;
+		if (result.error) {
+			stats.failed++;
+			console.error('Failed: ' + result.input + ': ' + result.error);
+		} else {
+			log(result.input);
+		}
+		stats.rendered += result.rendered;
+		stats.bytes += result.bytes;
+		idle.push(worker);
+		dispatch();
+	}
+
+	for (var i = 0; i < options.jobs; i++) {
+		spawn();
+	}
+
+	dispatch();
+}
+
+if (require.main !== module) {
+	// Loaded as a module, eg. by the tests.
+	module.exports = {
+		parseArgs: parseArgs,
+		globToRegExp: globToRegExp,
+		globDirTest: globDirTest,
+		InputWalker: InputWalker,
+		outputsFor: outputsFor,
+		overwritesInput: overwritesInput,
+		isUpToDate: isUpToDate
+	};
+} else if (process.argv[2] === '--worker') {
+	runWorker();
+} else {
+	var options;
+	try {
+		options = parseArgs(process.argv.slice(2));
+	} catch (error) {
+		console.error(error.message + '\n\n' + usage);
+		process.exit(2);
+	}
+	if (options.help || !options.inputs.length) {
+		console.log(usage);
+		process.exit(options.help ? 0 : 2);
+	}
+	runMaster(options);
+}
@@ -5,10 +5,19 @@
 			"sources": [
 				"src/Rsvg.cc",
 				"src/Enums.cc",
-				"src/Autocrop.cc"
+				"src/Autocrop.cc",
+				"src/Elements.cc",
+				"src/Probe.cc",
+				"src/Palette.cc",
+				"src/Compare.cc",
+				"src/RenderLimits.cc",
+				"src/Values.cc"
+			],
+			"defines": [
+				"NAPI_VERSION=6"
 			],
 			"variables": {
-				"packages": "librsvg-2.0 cairo-png cairo-pdf cairo-svg",
+				"packages": "librsvg-2.0 libxml-2.0 libpng cairo-png cairo-pdf cairo-svg",
 				"libraries": "<!(pkg-config --libs-only-l <(packages))",
 				"ldflags": "<!(pkg-config --libs-only-L --libs-only-other <(packages))",
 				"cflags": "<!(pkg-config --cflags <(packages))"
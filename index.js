@@ -4,6 +4,25 @@ var binding = require('./build/Release/rsvg');
 var Writable = require('stream').Writable;
 var util = require('util');
 
+/**
+ * Checks whether the value is a typed byte array (but not a Buffer).
+ * @private
+ */
+function isByteView(value) {
+	return typeof(Uint8Array) === 'function' && value instanceof Uint8Array;
+}
+
+/**
+ * Wrap the bytes of a Uint8Array in a Buffer, without copying when supported.
+ * @private
+ */
+function bufferFromView(view) {
+	if (typeof(Buffer.from) === 'function' && Buffer.from !== Uint8Array.from) {
+		return Buffer.from(view.buffer, view.byteOffset, view.byteLength);
+	}
+	return new Buffer(view);
+}
+
 /**
  * Represents one SVG file to be rendered. You can optionally pass the SVG file
  * directly as an argument (Buffer or string) to the constructor. Otherwise the
@@ -11,6 +30,13 @@ var util = require('util');
  * can initialize the writable stream with specific options if you pass an
  * object.
  *
+ * The SVG file can also be given as a Uint8Array, eg. a view on a
+ * SharedArrayBuffer. This allows the same bytes to be shared between worker
+ * threads, each creating their own instance without copying the file.
+ *
+ * Set the elements option to index the ids of the document for `elements()`.
+ * This takes an extra pass over the data, so it is off by default.
+ *
  * @see [LibRSVG Default Constructor]{@link
  * https://developer.gnome.org/rsvg/2.40/RsvgHandle.html#rsvg-handle-new}
  * @see [LibRSVG Constructor From Data]{@link
@@ -19,20 +45,24 @@ var util = require('util');
  * http://nodejs.org/api/stream.html#stream_new_stream_writable_options}
  *
  * @constructor
- * @param {(Buffer|string|Object)} [buffer] - SVG file.
+ * @param {(Buffer|Uint8Array|string|Object)} [buffer] - SVG file.
+ * @param {Object} [options] - Options, when the SVG file is given.
+ * @param {boolean} [options.elements] - Index element ids for `elements()`.
  */
-function Rsvg(buffer) {
+function Rsvg(buffer, options) {
 	var self = this;
 
 	// Create proper options for the writable stream super constructor.
-	var options;
 	if (Buffer.isBuffer(buffer)) {
-		options = {};
+		options = options || {};
 	} else if (typeof(buffer) === 'string') {
 		buffer = new Buffer(buffer);
-		options = {};
+		options = options || {};
 	} else if (buffer === undefined || buffer === null) {
-		options = {};
+		options = options || {};
+	} else if (isByteView(buffer)) {
+		buffer = bufferFromView(buffer);
+		options = options || {};
 	} else if (typeof(buffer) === 'object') {
 		options = buffer;
 		buffer = null;
@@ -45,7 +75,7 @@ function Rsvg(buffer) {
 
 	// Create new instance of binding.
 	try {
-		self.handle = new binding.Rsvg(buffer);
+		self.handle = new binding.Rsvg(buffer, !!options.elements);
 	} catch (error) {
 		throw new Error('Rsvg load failure: ' + error.message);
 	}
@@ -226,6 +256,27 @@ Rsvg.prototype.hasElement = function(id) {
 	return this.handle.hasElement(id);
 };
 
+/**
+ * List all elements with an id in the SVG document, along with their element
+ * type, position and size. The ids begin with "#", so they can be passed
+ * directly to the other methods.
+ *
+ * Only available when the elements option was given to the constructor. The
+ * list is cached until more data is written or the DPI or base URI change, and
+ * is frozen since every caller gets the same list.
+ *
+ * @returns {Array.<{id: string, type: string, x: number, y: number, width: number,
+ *   height: number}>}
+ */
+Rsvg.prototype.elements = function() {
+	var elements = this.handle.elements();
+	if (!Object.isFrozen(elements)) {
+		elements.forEach(Object.freeze);
+		Object.freeze(elements);
+	}
+	return elements;
+};
+
 /**
  * Find the drawing area, ie. the smallest area that has image content in the
  * SVG document.
@@ -242,10 +293,10 @@ Rsvg.prototype.autocrop = function() {
 };
 
 /**
- * Base render method. Valid high-level formats are: png, pdf, svg, raw. You
- * can also specify the pixel structure of raw images: argb32 (default), rgb24,
- * a8, a1, rgb16_565, and rgb30 (only enabled for Cairo >= 1.12). You can read
- * more about the low-level pixel formats in the [Cairo Documentation]{@link
+ * Base render method. Valid high-level formats are: png, png8, pdf, svg, raw.
+ * You can also specify the pixel structure of raw images: argb32 (default),
+ * rgb24, a8, a1, rgb16_565, and rgb30 (only enabled for Cairo >= 1.12). You can
+ * read more about the low-level pixel formats in the [Cairo Documentation]{@link
  * http://cairographics.org/manual/cairo-Image-Surfaces.html#cairo-format-t}.
  *
  * If the element property is given, only that subelement is rendered.
@@ -253,11 +304,36 @@ Rsvg.prototype.autocrop = function() {
  * The PNG format is the slowest of them all, since it takes time to encode the
  * image as a PNG buffer.
  *
+ * The png8 format gives an indexed PNG image with a palette of at most 256
+ * colors, which is much smaller for flat color graphics like logos and icons.
+ * Images with more colors are quantized, optionally with dithering.
+ *
+ * With the record option, the drawing operations of the image (or subelement)
+ * are recorded once and replayed on later renders with the same option, in any
+ * size and format. This saves LibRSVG from interpreting the SVG document again,
+ * which makes repeated renders of complex documents much faster. Filter effects
+ * are rasterized when recording, at the original size of the document. The
+ * recordings are kept in memory, up to 16 per instance (one per element id),
+ * and dropped when more data is written or the DPI or base URI change.
+ *
+ * The draft quality gives a quick, lower quality preview, eg. while editing.
+ * For raster formats it renders at a fraction of the output size, half by
+ * default or as given by the resolution option, which is then scaled up with
+ * bilinear filtering. It also draws curves less precisely, except when
+ * replaying a recording. Antialiasing is not changed, LibRSVG sets it per shape
+ * from the shape-rendering property. Filter effects are still rendered, since
+ * LibRSVG can not skip them, but they are cheaper at a reduced resolution.
+ *
  * @param {Object} [options] - Rendering options.
  * @param {string} [options.format] - One of the formats listed above.
  * @param {number} [options.width] - Output image width, should be an integer.
  * @param {number} [options.height] - Output image height, should be an integer.
  * @param {string} [options.id] - Subelement to render.
+ * @param {boolean} [options.dither] - Dither quantized colors in png8 format.
+ * @param {boolean} [options.record] - Record once and replay the rendering.
+ * @param {string} [options.quality] - Set to "draft" for a fast preview.
+ * @param {number} [options.resolution] - Draft resolution, 0 < resolution <= 1
+ *   (0.5 by default).
  * @returns {{data: Buffer, format: string, width: number, height: number}}
  */
 Rsvg.prototype.render = function(options) {
@@ -271,7 +347,8 @@ Rsvg.prototype.render = function(options) {
 		options.width,
 		options.height,
 		options.format,
-		options.id
+		options.id,
+		options
 	);
 };
 
@@ -382,5 +459,82 @@ Rsvg.prototype.toString = function() {
 	return '{ [' + this.constructor.name + ']' + util.inspect(obj).slice(1);
 };
 
+/**
+ * Determine the size of a SVG file without parsing the whole document. Only
+ * the root element is read, unless its size can not be resolved from the
+ * width, height and viewBox attributes (eg. for font relative units), in which
+ * case the whole document is parsed. Absolute units are converted to pixels.
+ * The units are given as written, eg. "" for plain numbers, or null when the
+ * attribute is missing.
+ *
+ * @param {(Buffer|string)} buffer - SVG file.
+ * @returns {{width: number, height: number, viewBox: ?{x: number, y: number,
+ *   width: number, height: number}, widthUnit: ?string, heightUnit: ?string}}
+ */
+Rsvg.probe = function(buffer) {
+	if (typeof(buffer) === 'string') {
+		buffer = new Buffer(buffer);
+	} else if (isByteView(buffer) && !Buffer.isBuffer(buffer)) {
+		buffer = bufferFromView(buffer);
+	}
+
+	try {
+		return binding.Rsvg.probe(buffer);
+	} catch (error) {
+		throw new Error('Rsvg probe failure: ' + error.message);
+	}
+};
+
+/**
+ * Compare two raw images pixel by pixel, eg. renders of the same SVG file with
+ * different library versions. Both images must be rendered in the raw format
+ * with argb32 pixels and have the same size. Pixels count as mismatched when a
+ * channel differs by more than the tolerance.
+ *
+ * The optional diff image marks mismatched pixels red and pixels that differ
+ * within the tolerance yellow. Equal pixels are transparent.
+ *
+ * @param {Object} a - Raw image, as returned by render().
+ * @param {Object} b - Raw image, as returned by render().
+ * @param {Object} [options] - Comparison options.
+ * @param {number} [options.tolerance] - Allowed difference per channel, 0-255.
+ * @param {boolean} [options.diff] - Create a diff image.
+ * @returns {{mismatched: number, maxDelta: number, bounds: ?{x: number,
+ *   y: number, width: number, height: number}, diff: Object}}
+ */
+Rsvg.compare = function(a, b, options) {
+	options = options || {};
+	return binding.Rsvg.compare(a, b, options.tolerance || 0, !!options.diff);
+};
+
+/**
+ * Limit the resources used by renders. The limits apply to the whole process,
+ * including all worker threads. Renders exceeding the maximum number of pixels,
+ * or which would bring the memory reserved by renders in progress above the
+ * maximum, throw a RangeError with code "ERR_RSVG_PIXEL_LIMIT" or
+ * "ERR_RSVG_MEMORY_LIMIT". Sizes too large for cairo always give the pixel
+ * error. Only raster formats are limited. Palette PNG renders also reserve
+ * about 4 MB for quantization. A limit of 0 means unlimited, which is the
+ * default.
+ *
+ * @param {Object} limits - Render limits.
+ * @param {number} [limits.maxPixels] - Maximum width*height of one render.
+ * @param {number} [limits.maxBytes] - Maximum memory for renders in progress.
+ */
+Rsvg.setLimits = function(limits) {
+	limits = limits || {};
+	binding.Rsvg.setLimits(limits.maxPixels || 0, limits.maxBytes || 0);
+};
+
+/**
+ * Get the current render limits and the renders in progress in the process,
+ * with the memory reserved for them.
+ *
+ * @returns {{maxPixels: number, maxBytes: number, bytes: number, renders: number}}
+ */
+Rsvg.usage = function() {
+	return binding.Rsvg.usage();
+};
+
 // Export the Rsvg object.
 exports.Rsvg = Rsvg;
@@ -1,11 +1,9 @@
 
 #include "Rsvg.h"
 #include "RsvgCairo.h"
-#include <node.h>
+#include "Values.h"
 #include <cmath>
 
-using namespace v8;
-
 struct autocrop_region_t {
 	double top;
 	double bottom;
@@ -77,7 +75,7 @@ static uint32_t findEdge(uint8_t* data, int stride, int width, int height, int x
 	return (xd != 0) ? x0 : y0;
 }
 
-static bool AutocropRecursive(RsvgHandle* handle, autocrop_region_t* region, int direction) {
+static bool AutocropRecursive(napi_env env, RsvgHandle* handle, autocrop_region_t* region, int direction) {
 	const int width = 100;
 	const int height = 100;
 
@@ -100,9 +98,8 @@ static bool AutocropRecursive(RsvgHandle* handle, autocrop_region_t* region, int
 		cairo_destroy(cr);
 		cairo_surface_destroy(surface);
 
-		ThrowException(Exception::Error(String::New(
-			status ? cairo_status_to_string(status) : "Failed to render image."
-		)));
+		napi_throw_error(env, NULL,
+			status ? cairo_status_to_string(status) : "Failed to render image.");
 		return false;
 	}
 
@@ -125,7 +122,7 @@ static bool AutocropRecursive(RsvgHandle* handle, autocrop_region_t* region, int
 		sub.right = width;
 		cairo_device_to_user(cr, &sub.left, &sub.top);
 		cairo_device_to_user(cr, &sub.right, &sub.bottom);
-		success = AutocropRecursive(handle, &sub, direction);
+		success = AutocropRecursive(env, handle, &sub, direction);
 		region->top = sub.top;
 	} else if (direction == 2) {
 		int bottom = findEdge(data, stride, width, height, 0, -1) + 1;
@@ -135,7 +132,7 @@ static bool AutocropRecursive(RsvgHandle* handle, autocrop_region_t* region, int
 		sub.right = width;
 		cairo_device_to_user(cr, &sub.left, &sub.top);
 		cairo_device_to_user(cr, &sub.right, &sub.bottom);
-		success = AutocropRecursive(handle, &sub, direction);
+		success = AutocropRecursive(env, handle, &sub, direction);
 		region->bottom = sub.bottom;
 	} else if (direction == 3) {
 		int left = findEdge(data, stride, width, height, 1, 0);
@@ -145,7 +142,7 @@ static bool AutocropRecursive(RsvgHandle* handle, autocrop_region_t* region, int
 		sub.right = left + 1;
 		cairo_device_to_user(cr, &sub.left, &sub.top);
 		cairo_device_to_user(cr, &sub.right, &sub.bottom);
-		success = AutocropRecursive(handle, &sub, direction);
+		success = AutocropRecursive(env, handle, &sub, direction);
 		region->left = sub.left;
 	} else if (direction == 4) {
 		int right = findEdge(data, stride, width, height, -1, 0) + 1;
@@ -155,7 +152,7 @@ static bool AutocropRecursive(RsvgHandle* handle, autocrop_region_t* region, int
 		sub.right = right;
 		cairo_device_to_user(cr, &sub.left, &sub.top);
 		cairo_device_to_user(cr, &sub.right, &sub.bottom);
-		success = AutocropRecursive(handle, &sub, direction);
+		success = AutocropRecursive(env, handle, &sub, direction);
 		region->right = sub.right;
 	} else {
 		success = false;
@@ -166,25 +163,27 @@ static bool AutocropRecursive(RsvgHandle* handle, autocrop_region_t* region, int
 	return success;
 }
 
-Handle<Value> Rsvg::Autocrop(const Arguments& args) {
-	HandleScope scope;
-	Rsvg* obj = node::ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::Autocrop(napi_env env, napi_callback_info info) {
+	Rsvg* obj = Unwrap(env, info, 0, NULL);
+	if (!obj) {
+		return NULL;
+	}
 
 	RsvgDimensionData dimensions = { 0, 0, 0, 0 };
 	rsvg_handle_get_dimensions(obj->_handle, &dimensions);
-	autocrop_region_t area = { 0, dimensions.height, 0, dimensions.width };
-
-	if (AutocropRecursive(obj->_handle, &area, 1) &&
-			AutocropRecursive(obj->_handle, &area, 2) &&
-			AutocropRecursive(obj->_handle, &area, 3) &&
-			AutocropRecursive(obj->_handle, &area, 4)) {
-		Handle<ObjectTemplate> dimensions = ObjectTemplate::New();
-		dimensions->Set("x", Number::New(area.left));
-		dimensions->Set("y", Number::New(area.top));
-		dimensions->Set("width", Number::New(area.right - area.left));
-		dimensions->Set("height", Number::New(area.bottom - area.top));
-		return scope.Close(dimensions->NewInstance());
+	autocrop_region_t area = { 0, double(dimensions.height), 0, double(dimensions.width) };
+
+	if (AutocropRecursive(env, obj->_handle, &area, 1) &&
+			AutocropRecursive(env, obj->_handle, &area, 2) &&
+			AutocropRecursive(env, obj->_handle, &area, 3) &&
+			AutocropRecursive(env, obj->_handle, &area, 4)) {
+		napi_value dimensions = NewObject(env);
+		SetNamed(env, dimensions, "x", NewNumber(env, area.left));
+		SetNamed(env, dimensions, "y", NewNumber(env, area.top));
+		SetNamed(env, dimensions, "width", NewNumber(env, area.right - area.left));
+		SetNamed(env, dimensions, "height", NewNumber(env, area.bottom - area.top));
+		return dimensions;
 	} else {
-		return scope.Close(Undefined());
+		return NULL;
 	}
 }
@@ -0,0 +1,164 @@
+#include "Rsvg.h"
+#include "Values.h"
+#include <cstring>
+#include <string>
+
+const uint32_t DIFF_MISMATCH_COLOR = 0xFFFF0000;
+const uint32_t DIFF_TOLERATED_COLOR = 0xFFFFFF00;
+
+struct compare_image_t {
+	const uint8_t* data;
+	size_t length;
+	int width;
+	int height;
+	int stride;
+};
+
+static inline int channelDelta(uint32_t a, uint32_t b) {
+	int delta = 0;
+	for (int shift = 0; shift < 32; shift += 8) {
+		int d = int((a >> shift) & 0xFF) - int((b >> shift) & 0xFF);
+		if (d < 0) {
+			d = -d;
+		}
+		if (d > delta) {
+			delta = d;
+		}
+	}
+	return delta;
+}
+
+// Buffers from user land need not be aligned, eg. small pooled Buffers.
+static inline uint32_t LoadPixel(const uint8_t* row, int x) {
+	uint32_t pixel;
+	std::memcpy(&pixel, row + size_t(x) * 4, sizeof(pixel));
+	return pixel;
+}
+
+static bool GetImage(napi_env env, napi_value value, compare_image_t* image) {
+	if (!IsObject(env, value)) {
+		return false;
+	}
+	char* data = NULL;
+	if (!GetBufferData(env, GetNamed(env, value, "data"), &data, &image->length)) {
+		return false;
+	}
+	napi_value pixelFormat = GetNamed(env, value, "pixelFormat");
+	std::string pixelFormatString;
+	napi_valuetype pixelFormatType = napi_undefined;
+	napi_typeof(env, pixelFormat, &pixelFormatType);
+	if (!(pixelFormatType == napi_undefined || (pixelFormatType == napi_string &&
+			ToUtf8(env, pixelFormat, &pixelFormatString) && pixelFormatString == "argb32"))) {
+		return false;
+	}
+
+	image->data = reinterpret_cast<const uint8_t*>(data);
+	image->width = ToInt32(env, GetNamed(env, value, "width"));
+	image->height = ToInt32(env, GetNamed(env, value, "height"));
+	napi_value stride = GetNamed(env, value, "stride");
+	int64_t rowLength = int64_t(image->width) * 4;
+	image->stride = IsNumber(env, stride) ? ToInt32(env, stride) : int(MIN(rowLength, INT32_MAX));
+
+	return image->width > 0 && image->height > 0 &&
+		image->stride >= rowLength &&
+		image->length >= size_t(image->stride) * (image->height - 1) + size_t(rowLength);
+}
+
+napi_value Rsvg::Compare(napi_env env, napi_callback_info info) {
+	size_t argc = 4;
+	napi_value args[4];
+	napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+
+	compare_image_t a, b;
+	if (!GetImage(env, args[0], &a)) {
+		napi_throw_type_error(env, NULL, "Invalid argument: a");
+		return NULL;
+	}
+	if (!GetImage(env, args[1], &b)) {
+		napi_throw_type_error(env, NULL, "Invalid argument: b");
+		return NULL;
+	}
+	if (a.width != b.width || a.height != b.height) {
+		napi_throw_range_error(env, NULL, "Images have different sizes.");
+		return NULL;
+	}
+
+	int tolerance = ToInt32(env, args[2]);
+	bool wantDiff = ToBoolean(env, args[3]);
+
+	const int width = a.width;
+	const int height = a.height;
+	const size_t rowLength = size_t(width) * 4;
+	std::string diff;
+	if (wantDiff) {
+		diff.assign(rowLength * height, '\0');
+	}
+
+	int mismatched = 0;
+	int maxDelta = 0;
+	int x0 = width;
+	int y0 = height;
+	int x1 = -1;
+	int y1 = -1;
+
+	for (int y = 0; y < height; y++) {
+		const uint8_t* rowA = a.data + size_t(a.stride) * y;
+		const uint8_t* rowB = b.data + size_t(b.stride) * y;
+		// Most rows are identical, so compare whole rows first.
+		if (std::memcmp(rowA, rowB, rowLength) == 0) {
+			continue;
+		}
+
+		uint32_t* pixelsDiff = wantDiff ? reinterpret_cast<uint32_t*>(&diff[rowLength * y]) : NULL;
+		for (int x = 0; x < width; x++) {
+			uint32_t pixelA = LoadPixel(rowA, x);
+			uint32_t pixelB = LoadPixel(rowB, x);
+			if (pixelA == pixelB) {
+				continue;
+			}
+			int delta = channelDelta(pixelA, pixelB);
+			if (delta > maxDelta) {
+				maxDelta = delta;
+			}
+			if (delta <= tolerance) {
+				if (pixelsDiff) {
+					pixelsDiff[x] = DIFF_TOLERATED_COLOR;
+				}
+				continue;
+			}
+			mismatched++;
+			if (x < x0) x0 = x;
+			if (x > x1) x1 = x;
+			if (y < y0) y0 = y;
+			if (y > y1) y1 = y;
+			if (pixelsDiff) {
+				pixelsDiff[x] = DIFF_MISMATCH_COLOR;
+			}
+		}
+	}
+
+	napi_value result = NewObject(env);
+	SetNamed(env, result, "mismatched", NewInteger(env, mismatched));
+	SetNamed(env, result, "maxDelta", NewInteger(env, maxDelta));
+	if (mismatched) {
+		napi_value bounds = NewObject(env);
+		SetNamed(env, bounds, "x", NewInteger(env, x0));
+		SetNamed(env, bounds, "y", NewInteger(env, y0));
+		SetNamed(env, bounds, "width", NewInteger(env, x1 - x0 + 1));
+		SetNamed(env, bounds, "height", NewInteger(env, y1 - y0 + 1));
+		SetNamed(env, result, "bounds", bounds);
+	} else {
+		SetNamed(env, result, "bounds", Null(env));
+	}
+	if (wantDiff) {
+		napi_value image = NewObject(env);
+		SetNamed(env, image, "data", NewBuffer(env, diff.c_str(), diff.length()));
+		SetNamed(env, image, "format", NewString(env, "raw"));
+		SetNamed(env, image, "pixelFormat", NewString(env, "argb32"));
+		SetNamed(env, image, "width", NewInteger(env, width));
+		SetNamed(env, image, "height", NewInteger(env, height));
+		SetNamed(env, image, "stride", NewInteger(env, rowLength));
+		SetNamed(env, result, "diff", image);
+	}
+	return result;
+}
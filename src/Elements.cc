@@ -0,0 +1,130 @@
+#include "Rsvg.h"
+#include "RsvgCairo.h"
+#include "Values.h"
+#include <cstring>
+
+static void ScanStartElement(
+		void* ctx,
+		const xmlChar* localname,
+		const xmlChar* prefix,
+		const xmlChar* URI,
+		int nb_namespaces,
+		const xmlChar** namespaces,
+		int nb_attributes,
+		int nb_defaulted,
+		const xmlChar** attributes) {
+	std::vector<element_id_t>* ids = reinterpret_cast<std::vector<element_id_t>*>(ctx);
+
+	// Attributes are given as (localname, prefix, URI, value, end) tuples.
+	for (int i = 0; i < nb_attributes; i++) {
+		const xmlChar** attribute = attributes + i * 5;
+		if (attribute[1] || std::strcmp(reinterpret_cast<const char*>(attribute[0]), "id") != 0) {
+			continue;
+		}
+		element_id_t element;
+		element.id.assign(
+			reinterpret_cast<const char*>(attribute[3]),
+			attribute[4] - attribute[3]
+		);
+		element.type = reinterpret_cast<const char*>(localname);
+		ids->push_back(element);
+		break;
+	}
+}
+
+static void ScanError(void* ctx, const char* message, ...) {
+	// Parse errors are reported by LibRSVG, so ignore them here.
+}
+
+static xmlSAXHandler scanHandler;
+
+// xmlParseChunk() takes an int size, so feed large buffers in parts.
+const size_t SCAN_CHUNK_SIZE = 1 << 20;
+
+void Rsvg::InitScanHandler() {
+	std::memset(&scanHandler, 0, sizeof(scanHandler));
+	scanHandler.initialized = XML_SAX2_MAGIC;
+	scanHandler.startElementNs = ScanStartElement;
+	scanHandler.warning = ScanError;
+	scanHandler.error = ScanError;
+	scanHandler.fatalError = ScanError;
+}
+
+void Rsvg::ScanElements(const char* data, size_t length, bool terminate) {
+	if (!_indexElements) {
+		return;
+	}
+	if (!_scanner && !_scanned) {
+		_scanned = true;
+		_scanner = xmlCreatePushParserCtxt(&scanHandler, &_ids, NULL, 0, NULL);
+		if (_scanner) {
+			xmlCtxtUseOptions(_scanner, XML_PARSE_NONET | XML_PARSE_NOWARNING | XML_PARSE_NOERROR);
+		}
+	}
+	if (!_scanner) {
+		return;
+	}
+
+	size_t offset = 0;
+	do {
+		size_t size = MIN(SCAN_CHUNK_SIZE, length - offset);
+		offset += size;
+		bool last = terminate && offset == length;
+		if (xmlParseChunk(_scanner, data + offset - size, int(size), last) != 0 || last) {
+			// Keep what has been found so far, but stop scanning on errors.
+			xmlFreeParserCtxt(_scanner);
+			_scanner = NULL;
+			return;
+		}
+	} while (offset < length);
+}
+
+napi_value Rsvg::Elements(napi_env env, napi_callback_info info) {
+	Rsvg* obj = Unwrap(env, info, 0, NULL);
+	if (!obj) {
+		return NULL;
+	}
+
+	if (!obj->_indexElements) {
+		napi_throw_error(env, NULL, "Elements are not indexed, use the elements option.");
+		return NULL;
+	}
+
+	napi_value elements;
+	if (obj->_elements && napi_get_reference_value(env, obj->_elements, &elements) == napi_ok) {
+		return elements;
+	}
+
+	elements = NewArray(env);
+	uint32_t index = 0;
+	std::string id;
+
+	for (std::vector<element_id_t>::const_iterator it = obj->_ids.begin(); it != obj->_ids.end(); ++it) {
+		id = "#" + it->id;
+		if (!rsvg_handle_has_sub(obj->_handle, id.c_str())) {
+			continue;
+		}
+
+		RsvgPositionData position = { 0, 0 };
+		RsvgDimensionData dimensions = { 0, 0, 0, 0 };
+
+		gboolean hasPosition = rsvg_handle_get_position_sub(obj->_handle, &position, id.c_str());
+		gboolean hasDimensions = rsvg_handle_get_dimensions_sub(obj->_handle, &dimensions, id.c_str());
+
+		napi_value element = NewObject(env);
+		SetNamed(env, element, "id", NewString(env, id.c_str(), id.length()));
+		SetNamed(env, element, "type", NewString(env, it->type.c_str(), it->type.length()));
+		if (hasPosition) {
+			SetNamed(env, element, "x", NewInteger(env, position.x));
+			SetNamed(env, element, "y", NewInteger(env, position.y));
+		}
+		if (hasDimensions) {
+			SetNamed(env, element, "width", NewInteger(env, dimensions.width));
+			SetNamed(env, element, "height", NewInteger(env, dimensions.height));
+		}
+		napi_set_element(env, elements, index++, element);
+	}
+
+	napi_create_reference(env, elements, 1, &obj->_elements);
+	return elements;
+}
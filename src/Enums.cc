@@ -1,6 +1,7 @@
 
 #include "Enums.h"
 #include "RsvgCairo.h"
+#include "Values.h"
 #include <cstring>
 
 // Support for old Cairo 1.8.8.
@@ -8,8 +9,6 @@
 #define CAIRO_FORMAT_INVALID ((cairo_format_t) -1)
 #endif
 
-using namespace v8;
-
 render_format_t RenderFormatFromString(const char* formatString) {
 	if (!formatString) {
 		return RENDER_FORMAT_INVALID;
@@ -25,12 +24,14 @@ render_format_t RenderFormatFromString(const char* formatString) {
 		return RENDER_FORMAT_SVG;
 	} else if (std::strcmp(formatString, "vips") == 0) {
 		return RENDER_FORMAT_VIPS;
+	} else if (std::strcmp(formatString, "png8") == 0) {
+		return RENDER_FORMAT_PNG8;
 	} else {
 		return RENDER_FORMAT_INVALID;
 	}
 }
 
-Handle<Value> RenderFormatToString(render_format_t format) {
+napi_value RenderFormatToString(napi_env env, render_format_t format) {
 	const char* formatString =
 		format == RENDER_FORMAT_RAW ? "raw" :
 		format == RENDER_FORMAT_PNG ? "png" :
@@ -38,9 +39,10 @@ Handle<Value> RenderFormatToString(render_format_t format) {
 		format == RENDER_FORMAT_PDF ? "pdf" :
 		format == RENDER_FORMAT_SVG ? "svg" :
 		format == RENDER_FORMAT_VIPS ? "vips" :
+		format == RENDER_FORMAT_PNG8 ? "png8" :
 		NULL;
 
-	return formatString ? String::New(formatString) : Null();
+	return formatString ? NewString(env, formatString) : Null(env);
 }
 
 cairo_format_t CairoFormatFromString(const char* formatString) {
@@ -65,7 +67,7 @@ cairo_format_t CairoFormatFromString(const char* formatString) {
 	}
 }
 
-Handle<Value> CairoFormatToString(cairo_format_t format) {
+napi_value CairoFormatToString(napi_env env, cairo_format_t format) {
 	const char* formatString =
 		format == CAIRO_FORMAT_ARGB32 ? "argb32" :
 		format == CAIRO_FORMAT_RGB24 ? "rgb24" :
@@ -77,5 +79,5 @@ Handle<Value> CairoFormatToString(cairo_format_t format) {
 #endif
 		NULL;
 
-	return formatString ? String::New(formatString) : Null();
+	return formatString ? NewString(env, formatString) : Null(env);
 }
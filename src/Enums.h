@@ -2,7 +2,7 @@
 #define __ENUMS_H__
 
 #include <cairo.h>
-#include <node.h>
+#include <node_api.h>
 
 typedef enum {
 	RENDER_FORMAT_INVALID = -1,
@@ -11,12 +11,13 @@ typedef enum {
 	RENDER_FORMAT_JPEG = 2,
 	RENDER_FORMAT_PDF = 3,
 	RENDER_FORMAT_SVG = 4,
-	RENDER_FORMAT_VIPS = 5
+	RENDER_FORMAT_VIPS = 5,
+	RENDER_FORMAT_PNG8 = 6
 } render_format_t;
 
 render_format_t RenderFormatFromString(const char* formatString);
-v8::Handle<v8::Value> RenderFormatToString(render_format_t format);
+napi_value RenderFormatToString(napi_env env, render_format_t format);
 cairo_format_t CairoFormatFromString(const char* formatString);
-v8::Handle<v8::Value> CairoFormatToString(cairo_format_t format);
+napi_value CairoFormatToString(napi_env env, cairo_format_t format);
 
 #endif /*__ENUMS_H__*/
\ No newline at end of file
@@ -0,0 +1,366 @@
+#include "Palette.h"
+#include <png.h>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+// Colors are handled unpremultiplied as 0xAARRGGBB.
+static inline uint32_t channel(uint32_t color, int shift) {
+	return (color >> shift) & 0xFF;
+}
+
+static inline uint32_t unpremultiply(uint32_t pixel) {
+	uint32_t a = pixel >> 24;
+	if (a == 0) {
+		return 0;
+	} else if (a == 0xFF) {
+		return pixel;
+	}
+	uint32_t r = (channel(pixel, 16) * 255 + a / 2) / a;
+	uint32_t g = (channel(pixel, 8) * 255 + a / 2) / a;
+	uint32_t b = (channel(pixel, 0) * 255 + a / 2) / a;
+	return (a << 24) | (std::min(r, 255u) << 16) | (std::min(g, 255u) << 8) | std::min(b, 255u);
+}
+
+static inline int clamp(int value) {
+	return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+// Shifts of the alpha, red, green and blue channels.
+static const int SHIFTS[4] = { 24, 16, 8, 0 };
+
+// Histogram bins use the 4 most significant bits of each channel.
+static inline uint32_t binOf(int a, int r, int g, int b) {
+	return ((a >> 4) << 12) | ((r >> 4) << 8) | ((g >> 4) << 4) | (b >> 4);
+}
+
+struct palette_bin_t {
+	uint32_t count;
+	double sum[4];
+	uint8_t key[4];
+};
+
+struct palette_box_t {
+	size_t begin;
+	size_t end;
+	uint32_t count;
+	int channel;
+	int range;
+};
+
+struct bin_less_t {
+	const std::vector<palette_bin_t>* bins;
+	int channel;
+	bool operator()(uint32_t a, uint32_t b) const {
+		return (*bins)[a].key[channel] < (*bins)[b].key[channel];
+	}
+};
+
+static void measureBox(const std::vector<palette_bin_t>& bins, const std::vector<uint32_t>& order, palette_box_t* box) {
+	int low[4] = { 255, 255, 255, 255 };
+	int high[4] = { 0, 0, 0, 0 };
+	box->count = 0;
+	for (size_t i = box->begin; i < box->end; i++) {
+		const palette_bin_t& bin = bins[order[i]];
+		box->count += bin.count;
+		for (int c = 0; c < 4; c++) {
+			low[c] = std::min(low[c], int(bin.key[c]));
+			high[c] = std::max(high[c], int(bin.key[c]));
+		}
+	}
+	box->channel = 0;
+	box->range = -1;
+	for (int c = 0; c < 4; c++) {
+		if (high[c] - low[c] > box->range) {
+			box->range = high[c] - low[c];
+			box->channel = c;
+		}
+	}
+}
+
+// Median cut on the histogram bins.
+static void medianCut(const std::vector<palette_bin_t>& bins, std::vector<uint32_t>& order, std::vector<uint32_t>& palette, std::vector<int>& binColor) {
+	std::vector<palette_box_t> boxes;
+	palette_box_t first = { 0, order.size(), 0, 0, 0 };
+	measureBox(bins, order, &first);
+	boxes.push_back(first);
+
+	while (boxes.size() < 256) {
+		// Split the box with the widest channel range, weighted by pixel count.
+		int best = -1;
+		double bestScore = 0;
+		for (size_t i = 0; i < boxes.size(); i++) {
+			double score = double(boxes[i].range) * boxes[i].count;
+			if (boxes[i].end - boxes[i].begin > 1 && boxes[i].range > 0 && score > bestScore) {
+				best = i;
+				bestScore = score;
+			}
+		}
+		if (best == -1) {
+			break;
+		}
+
+		palette_box_t& box = boxes[best];
+		bin_less_t less = { &bins, box.channel };
+		std::sort(order.begin() + box.begin, order.begin() + box.end, less);
+
+		uint32_t half = box.count / 2;
+		uint32_t count = 0;
+		size_t split = box.begin;
+		while (split < box.end - 1 && count + bins[order[split]].count <= half) {
+			count += bins[order[split]].count;
+			split++;
+		}
+		if (split == box.begin) {
+			split++;
+		}
+
+		palette_box_t upper = { split, box.end, 0, 0, 0 };
+		box.end = split;
+		measureBox(bins, order, &box);
+		measureBox(bins, order, &upper);
+		boxes.push_back(upper);
+	}
+
+	for (size_t i = 0; i < boxes.size(); i++) {
+		double sum[4] = { 0, 0, 0, 0 };
+		for (size_t j = boxes[i].begin; j < boxes[i].end; j++) {
+			const palette_bin_t& bin = bins[order[j]];
+			for (int c = 0; c < 4; c++) {
+				sum[c] += bin.sum[c];
+			}
+			binColor[order[j]] = i;
+		}
+		uint32_t color = 0;
+		for (int c = 0; c < 4; c++) {
+			color |= uint32_t(clamp(int(sum[c] / boxes[i].count + 0.5))) << SHIFTS[c];
+		}
+		palette.push_back(color);
+	}
+}
+
+static int nearestColor(const std::vector<uint32_t>& palette, int a, int r, int g, int b) {
+	int best = 0;
+	int bestDistance = 0x7FFFFFFF;
+	for (size_t i = 0; i < palette.size(); i++) {
+		int da = int(channel(palette[i], 24)) - a;
+		int dr = int(channel(palette[i], 16)) - r;
+		int dg = int(channel(palette[i], 8)) - g;
+		int db = int(channel(palette[i], 0)) - b;
+		int distance = da * da + dr * dr + dg * dg + db * db;
+		if (distance < bestDistance) {
+			best = i;
+			bestDistance = distance;
+		}
+	}
+	return best;
+}
+
+// Build a palette of at most 256 colors and map every pixel to it.
+static void quantize(const std::vector<uint32_t>& pixels, int width, int height, bool dither, std::vector<uint32_t>& palette, std::vector<uint8_t>& indices) {
+	std::vector<palette_bin_t> bins(1 << 16);
+	for (size_t i = 0; i < pixels.size(); i++) {
+		uint32_t color = pixels[i];
+		palette_bin_t& bin = bins[binOf(channel(color, 24), channel(color, 16), channel(color, 8), channel(color, 0))];
+		bin.count++;
+		for (int c = 0; c < 4; c++) {
+			bin.sum[c] += channel(color, SHIFTS[c]);
+		}
+	}
+
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < bins.size(); i++) {
+		if (bins[i].count) {
+			for (int c = 0; c < 4; c++) {
+				bins[i].key[c] = ((i >> (SHIFTS[c] / 2)) & 0xF) << 4;
+			}
+			order.push_back(i);
+		}
+	}
+
+	// Nearest palette color per bin, -1 when not computed yet.
+	std::vector<int> binColor(bins.size(), -1);
+	medianCut(bins, order, palette, binColor);
+
+	// Dithered colors can land in empty bins, so look those up lazily.
+	std::vector<int> nearest(bins.size(), -1);
+
+	std::vector<int> errors;
+	if (dither) {
+		errors.assign(2 * (width + 2) * 4, 0);
+	}
+
+	for (int y = 0; y < height; y++) {
+		int* current = dither ? &errors[(y % 2) * (width + 2) * 4] : NULL;
+		int* next = dither ? &errors[((y + 1) % 2) * (width + 2) * 4] : NULL;
+		if (dither) {
+			std::fill(next, next + (width + 2) * 4, 0);
+		}
+
+		for (int x = 0; x < width; x++) {
+			uint32_t color = pixels[y * width + x];
+			int value[4];
+			for (int c = 0; c < 4; c++) {
+				value[c] = channel(color, SHIFTS[c]);
+				if (dither) {
+					value[c] = clamp(value[c] + current[(x + 1) * 4 + c] / 16);
+				}
+			}
+
+			uint32_t bin = binOf(value[0], value[1], value[2], value[3]);
+			int index = dither ? nearest[bin] : binColor[bin];
+			if (index == -1) {
+				index = nearest[bin] = nearestColor(palette, value[0], value[1], value[2], value[3]);
+			}
+			indices[y * width + x] = index;
+
+			if (dither) {
+				for (int c = 0; c < 4; c++) {
+					int error = value[c] - int(channel(palette[index], SHIFTS[c]));
+					current[(x + 2) * 4 + c] += error * 7;
+					next[x * 4 + c] += error * 3;
+					next[(x + 1) * 4 + c] += error * 5;
+					next[(x + 2) * 4 + c] += error;
+				}
+			}
+		}
+	}
+}
+
+// Collect the exact palette, or return false if there are more than 256 colors.
+static bool exactPalette(const std::vector<uint32_t>& pixels, std::vector<uint32_t>& palette, std::vector<uint8_t>& indices) {
+	// Open addressing hash table, kept at most half full.
+	const uint32_t size = 512;
+	uint32_t keys[size];
+	int values[size];
+	std::fill(values, values + size, -1);
+
+	uint32_t last = 0;
+	int lastIndex = -1;
+	for (size_t i = 0; i < pixels.size(); i++) {
+		uint32_t color = pixels[i];
+		if (color != last || lastIndex == -1) {
+			uint32_t slot = (color * 2654435761u) >> 23;
+			while (values[slot] != -1 && keys[slot] != color) {
+				slot = (slot + 1) & (size - 1);
+			}
+			if (values[slot] == -1) {
+				if (palette.size() == 256) {
+					return false;
+				}
+				keys[slot] = color;
+				values[slot] = palette.size();
+				palette.push_back(color);
+			}
+			last = color;
+			lastIndex = values[slot];
+		}
+		indices[i] = lastIndex;
+	}
+	return true;
+}
+
+static void WriteChunks(png_structp png, png_bytep chunk, png_size_t length) {
+	std::string* data = reinterpret_cast<std::string*>(png_get_io_ptr(png));
+	data->append(reinterpret_cast<const char*>(chunk), length);
+}
+
+static void FlushChunks(png_structp png) {}
+
+static bool WritePNG(std::string* data, int width, int height, int depth, png_colorp colors, int colorCount, png_bytep alphas, int alphaCount, png_bytepp rows) {
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (!png) {
+		return false;
+	}
+	png_infop info = png_create_info_struct(png);
+	if (!info || setjmp(png_jmpbuf(png))) {
+		png_destroy_write_struct(&png, &info);
+		return false;
+	}
+
+	png_set_write_fn(png, data, WriteChunks, FlushChunks);
+	png_set_IHDR(
+		png, info, width, height, depth, PNG_COLOR_TYPE_PALETTE,
+		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT
+	);
+	png_set_PLTE(png, info, colors, colorCount);
+	if (alphaCount > 0) {
+		png_set_tRNS(png, info, alphas, alphaCount, NULL);
+	}
+	png_set_rows(png, info, rows);
+	png_write_png(png, info, PNG_TRANSFORM_PACKING, NULL);
+	png_destroy_write_struct(&png, &info);
+	return true;
+}
+
+int64_t PalettePNGBytes(int width, int height) {
+	const int64_t bins = 1 << 16;
+	int64_t pixels = int64_t(width) * height;
+	// Unpremultiplied pixels, palette indices and row pointers.
+	int64_t bytes = pixels * (sizeof(uint32_t) + sizeof(uint8_t)) + int64_t(height) * sizeof(png_bytep);
+	// Quantization: the histogram, the bin order, the palette color per bin
+	// and the nearest colors for dithering, plus two rows of errors.
+	bytes += bins * (sizeof(palette_bin_t) + sizeof(uint32_t) + 2 * sizeof(int));
+	bytes += 2 * (int64_t(width) + 2) * 4 * sizeof(int);
+	return bytes;
+}
+
+bool WritePalettePNG(cairo_surface_t* surface, std::string* data, bool dither) {
+	if (cairo_image_surface_get_format(surface) != CAIRO_FORMAT_ARGB32) {
+		return false;
+	}
+
+	int width = cairo_image_surface_get_width(surface);
+	int height = cairo_image_surface_get_height(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+	uint8_t* surfaceData = cairo_image_surface_get_data(surface);
+
+	std::vector<uint32_t> pixels(size_t(width) * height);
+	for (int y = 0; y < height; y++) {
+		const uint32_t* row = reinterpret_cast<const uint32_t*>(surfaceData + stride * y);
+		for (int x = 0; x < width; x++) {
+			pixels[y * width + x] = unpremultiply(row[x]);
+		}
+	}
+
+	std::vector<uint32_t> palette;
+	std::vector<uint8_t> indices(pixels.size());
+	if (!exactPalette(pixels, palette, indices)) {
+		palette.clear();
+		quantize(pixels, width, height, dither, palette, indices);
+	}
+	std::vector<uint32_t>().swap(pixels);
+
+	// Put translucent colors first, so the tRNS chunk can be as short as possible.
+	std::vector<uint8_t> remap(palette.size());
+	png_color colors[256];
+	png_byte alphas[256];
+	int alphaCount = 0;
+	int colorCount = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t i = 0; i < palette.size(); i++) {
+			bool opaque = channel(palette[i], 24) == 0xFF;
+			if (opaque != (pass == 1)) {
+				continue;
+			}
+			colors[colorCount].red = channel(palette[i], 16);
+			colors[colorCount].green = channel(palette[i], 8);
+			colors[colorCount].blue = channel(palette[i], 0);
+			if (!opaque) {
+				alphas[alphaCount++] = channel(palette[i], 24);
+			}
+			remap[i] = colorCount++;
+		}
+	}
+
+	std::vector<png_bytep> rows(height);
+	for (int y = 0; y < height; y++) {
+		rows[y] = &indices[y * width];
+		for (int x = 0; x < width; x++) {
+			rows[y][x] = remap[rows[y][x]];
+		}
+	}
+
+	int depth = colorCount <= 2 ? 1 : colorCount <= 4 ? 2 : colorCount <= 16 ? 4 : 8;
+	return WritePNG(data, width, height, depth, colors, colorCount, alphas, alphaCount, height ? &rows[0] : NULL);
+}
@@ -0,0 +1,17 @@
+#ifndef __PALETTE_H__
+#define __PALETTE_H__
+
+#include <cairo.h>
+#include <stdint.h>
+#include <string>
+
+// Write an ARGB32 image surface as an indexed (palette) PNG image. Images with
+// at most 256 colors are written losslessly, otherwise the colors are
+// quantized with median cut and optionally Floyd-Steinberg dithering.
+bool WritePalettePNG(cairo_surface_t* surface, std::string* data, bool dither);
+
+// Upper bound of the memory used by WritePalettePNG() besides the surface and
+// the encoded data, in bytes.
+int64_t PalettePNGBytes(int width, int height);
+
+#endif /*__PALETTE_H__*/
@@ -0,0 +1,241 @@
+#include "Rsvg.h"
+#include "RsvgCairo.h"
+#include "Values.h"
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+struct probe_t {
+	xmlParserCtxtPtr parser;
+	bool found;
+	bool isSvg;
+	bool hasWidth;
+	bool hasHeight;
+	bool hasViewBox;
+	std::string width;
+	std::string height;
+	std::string viewBox;
+};
+
+struct probe_length_t {
+	double value;
+	std::string unit;
+};
+
+// Only the root element is needed, so feed the parser in small chunks.
+const size_t PROBE_CHUNK_SIZE = 4096;
+
+static void ProbeStartElement(
+		void* ctx,
+		const xmlChar* localname,
+		const xmlChar* prefix,
+		const xmlChar* URI,
+		int nb_namespaces,
+		const xmlChar** namespaces,
+		int nb_attributes,
+		int nb_defaulted,
+		const xmlChar** attributes) {
+	probe_t* probe = reinterpret_cast<probe_t*>(ctx);
+	probe->found = true;
+	probe->isSvg = std::strcmp(reinterpret_cast<const char*>(localname), "svg") == 0;
+
+	// Attributes are given as (localname, prefix, URI, value, end) tuples.
+	for (int i = 0; i < nb_attributes; i++) {
+		const xmlChar** attribute = attributes + i * 5;
+		if (attribute[1]) {
+			continue;
+		}
+		const char* name = reinterpret_cast<const char*>(attribute[0]);
+		std::string value(
+			reinterpret_cast<const char*>(attribute[3]),
+			attribute[4] - attribute[3]
+		);
+		if (std::strcmp(name, "width") == 0) {
+			probe->hasWidth = true;
+			probe->width = value;
+		} else if (std::strcmp(name, "height") == 0) {
+			probe->hasHeight = true;
+			probe->height = value;
+		} else if (std::strcmp(name, "viewBox") == 0) {
+			probe->hasViewBox = true;
+			probe->viewBox = value;
+		}
+	}
+
+	xmlStopParser(probe->parser);
+}
+
+static void ProbeError(void* ctx, const char* message, ...) {
+	// Undecidable documents fall back to a full parse, which reports errors.
+}
+
+static xmlSAXHandler probeHandler;
+static double probeDPI = 0;
+
+void Rsvg::InitProbe() {
+	// Absolute units are resolved with the default DPI of new handles.
+	RsvgHandle* handle = rsvg_handle_new();
+	if (handle) {
+		gdouble dpi = 0;
+		g_object_get(G_OBJECT(handle), "dpi-x", &dpi, NULL);
+		probeDPI = dpi;
+		g_object_unref(G_OBJECT(handle));
+	}
+
+	std::memset(&probeHandler, 0, sizeof(probeHandler));
+	probeHandler.initialized = XML_SAX2_MAGIC;
+	probeHandler.startElementNs = ProbeStartElement;
+	probeHandler.warning = ProbeError;
+	probeHandler.error = ProbeError;
+	probeHandler.fatalError = ProbeError;
+}
+
+static bool ParseLength(const std::string& text, probe_length_t* length) {
+	const char* start = text.c_str();
+	char* end = NULL;
+	length->value = std::strtod(start, &end);
+	if (end == start || std::isnan(length->value) || std::isinf(length->value)) {
+		return false;
+	}
+	while (*end == ' ' || *end == '\t' || *end == '\n' || *end == '\r') {
+		end++;
+	}
+	length->unit = end;
+	while (!length->unit.empty() &&
+			std::strchr(" \t\n\r", length->unit[length->unit.length() - 1])) {
+		length->unit.erase(length->unit.length() - 1);
+	}
+	return true;
+}
+
+static bool ParseViewBox(const std::string& text, double values[4]) {
+	const char* current = text.c_str();
+	for (int i = 0; i < 4; i++) {
+		while (*current == ' ' || *current == ',' || *current == '\t' ||
+				*current == '\n' || *current == '\r') {
+			current++;
+		}
+		char* end = NULL;
+		values[i] = std::strtod(current, &end);
+		if (end == current) {
+			return false;
+		}
+		current = end;
+	}
+	return values[2] > 0 && values[3] > 0;
+}
+
+// Resolve a length to pixels. Percentages are relative to the view box and
+// font relative units can not be resolved without a full parse.
+static bool ResolveLength(const probe_length_t& length, double dpi, double reference, double* pixels) {
+	const char* unit = length.unit.c_str();
+	if (!*unit || std::strcmp(unit, "px") == 0) {
+		*pixels = length.value;
+	} else if (std::strcmp(unit, "pt") == 0) {
+		*pixels = length.value * dpi / 72.0;
+	} else if (std::strcmp(unit, "pc") == 0) {
+		*pixels = length.value * dpi / 6.0;
+	} else if (std::strcmp(unit, "in") == 0) {
+		*pixels = length.value * dpi;
+	} else if (std::strcmp(unit, "cm") == 0) {
+		*pixels = length.value * dpi / 2.54;
+	} else if (std::strcmp(unit, "mm") == 0) {
+		*pixels = length.value * dpi / 25.4;
+	} else if (std::strcmp(unit, "%") == 0 && reference > 0) {
+		*pixels = length.value * reference / 100.0;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+
+napi_value Rsvg::Probe(napi_env env, napi_callback_info info) {
+	size_t argc = 1;
+	napi_value args[1];
+	napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+
+	char* data = NULL;
+	size_t length = 0;
+	if (!GetBufferData(env, args[0], &data, &length)) {
+		napi_throw_type_error(env, NULL, "Invalid argument: buffer");
+		return NULL;
+	}
+
+	probe_t probe;
+	probe.found = false;
+	probe.isSvg = false;
+	probe.hasWidth = false;
+	probe.hasHeight = false;
+	probe.hasViewBox = false;
+	probe.parser = xmlCreatePushParserCtxt(&probeHandler, &probe, NULL, 0, NULL);
+
+	if (probe.parser) {
+		xmlCtxtUseOptions(probe.parser, XML_PARSE_NONET | XML_PARSE_NOWARNING | XML_PARSE_NOERROR);
+		for (size_t offset = 0; offset < length && !probe.found; offset += PROBE_CHUNK_SIZE) {
+			size_t size = MIN(PROBE_CHUNK_SIZE, length - offset);
+			if (xmlParseChunk(probe.parser, data + offset, int(size), 0) != 0) {
+				break;
+			}
+		}
+		xmlFreeParserCtxt(probe.parser);
+		probe.parser = NULL;
+	}
+
+	double viewBox[4] = { 0, 0, 0, 0 };
+	bool hasViewBox = probe.hasViewBox && ParseViewBox(probe.viewBox, viewBox);
+
+	probe_length_t widthLength = { 100, "%" };
+	probe_length_t heightLength = { 100, "%" };
+	bool decided = probe.isSvg &&
+		(!probe.hasWidth || ParseLength(probe.width, &widthLength)) &&
+		(!probe.hasHeight || ParseLength(probe.height, &heightLength));
+
+	double width = 0;
+	double height = 0;
+	if (decided) {
+		decided =
+			ResolveLength(widthLength, probeDPI, hasViewBox ? viewBox[2] : 0, &width) &&
+			ResolveLength(heightLength, probeDPI, hasViewBox ? viewBox[3] : 0, &height);
+	}
+
+	if (!decided) {
+		// Fall back to a full parse of the document.
+		GError* error = NULL;
+		RsvgHandle* handle = rsvg_handle_new_from_data(
+			reinterpret_cast<const guint8*>(data), length, &error);
+		if (error) {
+			napi_throw_error(env, NULL, error->message);
+			g_error_free(error);
+			return NULL;
+		}
+		if (!handle) {
+			napi_throw_error(env, NULL, "Unable to create RsvgHandle instance.");
+			return NULL;
+		}
+		RsvgDimensionData dimensions = { 0, 0, 0, 0 };
+		rsvg_handle_get_dimensions(handle, &dimensions);
+		g_object_unref(G_OBJECT(handle));
+		width = dimensions.width;
+		height = dimensions.height;
+	}
+
+	napi_value result = NewObject(env);
+	SetNamed(env, result, "width", NewInteger(env, floor(width + 0.5)));
+	SetNamed(env, result, "height", NewInteger(env, floor(height + 0.5)));
+	if (hasViewBox) {
+		napi_value box = NewObject(env);
+		SetNamed(env, box, "x", NewNumber(env, viewBox[0]));
+		SetNamed(env, box, "y", NewNumber(env, viewBox[1]));
+		SetNamed(env, box, "width", NewNumber(env, viewBox[2]));
+		SetNamed(env, box, "height", NewNumber(env, viewBox[3]));
+		SetNamed(env, result, "viewBox", box);
+	} else {
+		SetNamed(env, result, "viewBox", Null(env));
+	}
+	SetNamed(env, result, "widthUnit",
+		probe.hasWidth ? NewString(env, widthLength.unit.c_str()) : Null(env));
+	SetNamed(env, result, "heightUnit",
+		probe.hasHeight ? NewString(env, heightLength.unit.c_str()) : Null(env));
+	return result;
+}
@@ -0,0 +1,60 @@
+#include "RenderLimits.h"
+#include <uv.h>
+
+static uv_once_t limitsOnce = UV_ONCE_INIT;
+static uv_mutex_t limitsMutex;
+static render_limits_t limits = { 0, 0, 0, 0 };
+
+static void InitMutex() {
+	uv_mutex_init(&limitsMutex);
+}
+
+void InitRenderLimits() {
+	uv_once(&limitsOnce, InitMutex);
+}
+
+void SetRenderLimits(int64_t maxPixels, int64_t maxBytes) {
+	uv_mutex_lock(&limitsMutex);
+	limits.maxPixels = maxPixels > 0 ? maxPixels : 0;
+	limits.maxBytes = maxBytes > 0 ? maxBytes : 0;
+	uv_mutex_unlock(&limitsMutex);
+}
+
+render_limits_t GetRenderLimits() {
+	uv_mutex_lock(&limitsMutex);
+	render_limits_t current = limits;
+	uv_mutex_unlock(&limitsMutex);
+	return current;
+}
+
+bool CheckRenderPixels(int64_t pixels) {
+	uv_mutex_lock(&limitsMutex);
+	bool allowed = limits.maxPixels == 0 || pixels <= limits.maxPixels;
+	uv_mutex_unlock(&limitsMutex);
+	return allowed;
+}
+
+RenderReservation::~RenderReservation() {
+	if (_bytes == 0) {
+		return;
+	}
+	uv_mutex_lock(&limitsMutex);
+	limits.bytes -= _bytes;
+	limits.renders--;
+	uv_mutex_unlock(&limitsMutex);
+}
+
+bool RenderReservation::Acquire(int64_t bytes) {
+	if (bytes < 0) {
+		return false;
+	}
+	uv_mutex_lock(&limitsMutex);
+	bool allowed = limits.maxBytes == 0 || limits.bytes + bytes <= limits.maxBytes;
+	if (allowed && bytes > 0) {
+		limits.bytes += bytes;
+		limits.renders++;
+		_bytes = bytes;
+	}
+	uv_mutex_unlock(&limitsMutex);
+	return allowed;
+}
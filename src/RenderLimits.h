@@ -0,0 +1,31 @@
+#ifndef __RENDERLIMITS_H__
+#define __RENDERLIMITS_H__
+
+#include <stdint.h>
+
+// Process wide limits on render requests, shared by all threads. A limit of 0
+// means unlimited.
+typedef struct {
+	int64_t maxPixels;
+	int64_t maxBytes;
+	int64_t bytes;
+	int renders;
+} render_limits_t;
+
+void InitRenderLimits();
+void SetRenderLimits(int64_t maxPixels, int64_t maxBytes);
+render_limits_t GetRenderLimits();
+bool CheckRenderPixels(int64_t pixels);
+
+// Reserves memory for one render for as long as it's in scope.
+class RenderReservation {
+public:
+	RenderReservation() : _bytes(0) {}
+	~RenderReservation();
+	bool Acquire(int64_t bytes);
+
+private:
+	int64_t _bytes;
+};
+
+#endif /*__RENDERLIMITS_H__*/
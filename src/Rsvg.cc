@@ -2,14 +2,39 @@
 #include "Rsvg.h"
 #include "RsvgCairo.h"
 #include "Enums.h"
-#include <node_buffer.h>
+#include "Palette.h"
+#include "RenderLimits.h"
+#include "Values.h"
 #include <cairo-pdf.h>
 #include <cairo-svg.h>
+#include <uv.h>
 #include <string>
+#include <cstring>
 #include <cmath>
 
-using namespace v8;
-using namespace node;
+// Draft renders trade resolution and curve precision for speed. LibRSVG sets
+// the antialiasing of each shape from its shape-rendering property, so that
+// is left alone.
+const double DRAFT_RESOLUTION = 0.5;
+const double DRAFT_TOLERANCE = 1.0;
+
+// Recordings keep all drawing operations (and rasterized filter effects) in
+// memory, so only keep a few per instance.
+const size_t MAX_RECORDINGS = 16;
+
+// State of one loaded instance of the addon. The main thread and every worker
+// thread load their own instance, so no JavaScript objects are shared.
+struct rsvg_addon_t {
+	napi_ref constructor;
+};
+
+static void DestroyAddon(napi_env env, void* data, void* hint) {
+	rsvg_addon_t* addon = reinterpret_cast<rsvg_addon_t*>(data);
+	napi_delete_reference(env, addon->constructor);
+	delete addon;
+}
+
+static uv_once_t parsersOnce = UV_ONCE_INIT;
 
 cairo_status_t GetDataChunks(void* closure, const unsigned char* chunk, unsigned int length) {
 	std::string* data = reinterpret_cast<std::string*>(closure);
@@ -17,100 +42,229 @@ cairo_status_t GetDataChunks(void* closure, const unsigned char* chunk, unsigned
 	return CAIRO_STATUS_SUCCESS;
 }
 
-Persistent<Function> Rsvg::constructor;
-
-Rsvg::Rsvg(RsvgHandle* const handle) : _handle(handle) {}
+Rsvg::Rsvg(napi_env env, RsvgHandle* const handle, bool indexElements) :
+	_env(env), _handle(handle), _indexElements(indexElements),
+	_scanner(NULL), _scanned(false), _elements(NULL), _recordingUses(0) {}
 
 Rsvg::~Rsvg() {
+	if (_scanner) {
+		xmlFreeParserCtxt(_scanner);
+	}
+	ResetCache();
 	g_object_unref(G_OBJECT(_handle));
 }
 
-void Rsvg::Init(Handle<Object> exports) {
+// Set up libxml2 and the SAX handlers once per process, before any thread
+// parses with them.
+void Rsvg::InitParsers() {
+	xmlInitParser();
+	InitScanHandler();
+	InitProbe();
+}
+
+void Rsvg::Destroy(napi_env env, void* data, void* hint) {
+	delete reinterpret_cast<Rsvg*>(data);
+}
+
+Rsvg* Rsvg::Unwrap(napi_env env, napi_callback_info info, size_t argc, napi_value* args) {
+	napi_value self;
+	void* obj = NULL;
+	napi_get_cb_info(env, info, &argc, args, &self, NULL);
+	if (napi_unwrap(env, self, &obj) != napi_ok || !obj) {
+		napi_throw_type_error(env, NULL, "Illegal invocation.");
+		return NULL;
+	}
+	return reinterpret_cast<Rsvg*>(obj);
+}
+
+void Rsvg::ResetCache() {
+	if (_elements) {
+		napi_delete_reference(_env, _elements);
+		_elements = NULL;
+	}
+	for (std::map<std::string, recording_t>::iterator it = _recordings.begin(); it != _recordings.end(); ++it) {
+		cairo_surface_destroy(it->second.surface);
+	}
+	_recordings.clear();
+}
+
+// Get the drawing operations of the whole image or a subelement, recorded once
+// and replayed on later renders. Returns NULL if recording is not possible.
+cairo_surface_t* Rsvg::Recording(const char* id) {
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 10, 0)
+	std::string key(id ? id : "");
+	std::map<std::string, recording_t>::iterator it = _recordings.find(key);
+	if (it != _recordings.end()) {
+		it->second.used = ++_recordingUses;
+		return it->second.surface;
+	}
+
+	if (_recordings.size() >= MAX_RECORDINGS) {
+		// Drop the least recently used recording.
+		std::map<std::string, recording_t>::iterator oldest = _recordings.begin();
+		for (it = _recordings.begin(); it != _recordings.end(); ++it) {
+			if (it->second.used < oldest->second.used) {
+				oldest = it;
+			}
+		}
+		cairo_surface_destroy(oldest->second.surface);
+		_recordings.erase(oldest);
+	}
+
+	cairo_surface_t* recording = cairo_recording_surface_create(CAIRO_CONTENT_COLOR_ALPHA, NULL);
+	cairo_t* cr = cairo_create(recording);
+	gboolean success;
+	if (id) {
+		success = rsvg_handle_render_cairo_sub(_handle, cr, id);
+	} else {
+		success = rsvg_handle_render_cairo(_handle, cr);
+	}
+	cairo_status_t status = cairo_status(cr);
+	cairo_destroy(cr);
+
+	if (status || !success) {
+		cairo_surface_destroy(recording);
+		return NULL;
+	}
+	recording_t entry = { recording, ++_recordingUses };
+	_recordings[key] = entry;
+	return recording;
+#else
+	return NULL;
+#endif
+}
+
+#define RSVG_METHOD(name, callback) \
+	{ name, NULL, callback, NULL, NULL, NULL, \
+		static_cast<napi_property_attributes>(napi_writable | napi_configurable), NULL }
+#define RSVG_STATIC_METHOD(name, callback) \
+	{ name, NULL, callback, NULL, NULL, NULL, \
+		static_cast<napi_property_attributes>(napi_writable | napi_configurable | napi_static), NULL }
+
+napi_value Rsvg::Init(napi_env env, napi_value exports) {
 
 #if !GLIB_CHECK_VERSION(2, 36, 0)
-	// Initialize GObject types.
+	// Initialize GObject types. Safe to call once per loaded instance.
 	g_type_init();
 #endif
 
-	// Prepare constructor template.
-	Local<FunctionTemplate> tpl = FunctionTemplate::New(New);
-	tpl->SetClassName(String::NewSymbol("Rsvg"));
-	tpl->InstanceTemplate()->SetInternalFieldCount(1);
-	// Add methods to prototype.
-	Local<ObjectTemplate> prototype = tpl->PrototypeTemplate();
-	prototype->Set("getBaseURI", FunctionTemplate::New(GetBaseURI)->GetFunction());
-	prototype->Set("setBaseURI", FunctionTemplate::New(SetBaseURI)->GetFunction());
-	prototype->Set("getDPI", FunctionTemplate::New(GetDPI)->GetFunction());
-	prototype->Set("setDPI", FunctionTemplate::New(SetDPI)->GetFunction());
-	prototype->Set("getDPIX", FunctionTemplate::New(GetDPIX)->GetFunction());
-	prototype->Set("setDPIX", FunctionTemplate::New(SetDPIX)->GetFunction());
-	prototype->Set("getDPIY", FunctionTemplate::New(GetDPIY)->GetFunction());
-	prototype->Set("setDPIY", FunctionTemplate::New(SetDPIY)->GetFunction());
-	prototype->Set("getWidth", FunctionTemplate::New(GetWidth)->GetFunction());
-	prototype->Set("getHeight", FunctionTemplate::New(GetHeight)->GetFunction());
-	prototype->Set("write", FunctionTemplate::New(Write)->GetFunction());
-	prototype->Set("close", FunctionTemplate::New(Close)->GetFunction());
-	prototype->Set("dimensions", FunctionTemplate::New(Dimensions)->GetFunction());
-	prototype->Set("hasElement", FunctionTemplate::New(HasElement)->GetFunction());
-	prototype->Set("autocrop", FunctionTemplate::New(Autocrop)->GetFunction());
-	prototype->Set("render", FunctionTemplate::New(Render)->GetFunction());
+	InitRenderLimits();
+	uv_once(&parsersOnce, InitParsers);
+
+	napi_property_descriptor properties[] = {
+		// Add methods to prototype.
+		RSVG_METHOD("getBaseURI", GetBaseURI),
+		RSVG_METHOD("setBaseURI", SetBaseURI),
+		RSVG_METHOD("getDPI", GetDPI),
+		RSVG_METHOD("setDPI", SetDPI),
+		RSVG_METHOD("getDPIX", GetDPIX),
+		RSVG_METHOD("setDPIX", SetDPIX),
+		RSVG_METHOD("getDPIY", GetDPIY),
+		RSVG_METHOD("setDPIY", SetDPIY),
+		RSVG_METHOD("getWidth", GetWidth),
+		RSVG_METHOD("getHeight", GetHeight),
+		RSVG_METHOD("write", Write),
+		RSVG_METHOD("close", Close),
+		RSVG_METHOD("dimensions", Dimensions),
+		RSVG_METHOD("hasElement", HasElement),
+		RSVG_METHOD("elements", Elements),
+		RSVG_METHOD("autocrop", Autocrop),
+		RSVG_METHOD("render", Render),
+		// Add static methods.
+		RSVG_STATIC_METHOD("probe", Probe),
+		RSVG_STATIC_METHOD("compare", Compare),
+		RSVG_STATIC_METHOD("setLimits", SetLimits),
+		RSVG_STATIC_METHOD("usage", Usage)
+	};
+
+	// Prepare constructor.
+	napi_value constructor;
+	napi_status status = napi_define_class(
+		env, "Rsvg", NAPI_AUTO_LENGTH, New, NULL,
+		sizeof(properties) / sizeof(properties[0]), properties, &constructor
+	);
+	if (status != napi_ok) {
+		return NULL;
+	}
+
+	// Keep the constructor in the instance data instead of a static, since the
+	// addon is loaded once per thread.
+	rsvg_addon_t* addon = new rsvg_addon_t();
+	napi_create_reference(env, constructor, 1, &addon->constructor);
+	napi_set_instance_data(env, addon, DestroyAddon, NULL);
+
 	// Export class.
-	constructor = Persistent<Function>::New(tpl->GetFunction());
-	exports->Set(String::New("Rsvg"), constructor);
+	SetNamed(env, exports, "Rsvg", constructor);
+	return exports;
 }
 
-Handle<Value> Rsvg::New(const Arguments& args) {
-	HandleScope scope;
+napi_value Rsvg::New(napi_env env, napi_callback_info info) {
+	size_t argc = 2;
+	napi_value args[2];
+	napi_value self;
+	napi_value target = NULL;
+	napi_get_cb_info(env, info, &argc, args, &self, NULL);
+	napi_get_new_target(env, info, &target);
 
-	if (args.IsConstructCall()) {
+	if (target) {
 		// Invoked as constructor: `new Rsvg(...)`
+		char* data = NULL;
+		size_t length = 0;
+		bool hasData = GetBufferData(env, args[0], &data, &length);
 		RsvgHandle* handle;
-		if (Buffer::HasInstance(args[0])) {
-			const guint8* buffer =
-				reinterpret_cast<guint8*>(Buffer::Data(args[0]));
-			gsize length = Buffer::Length(args[0]);
-
+		if (hasData) {
 			GError* error = NULL;
-			handle = rsvg_handle_new_from_data(buffer, length, &error);
+			handle = rsvg_handle_new_from_data(reinterpret_cast<guint8*>(data), length, &error);
 
 			if (error) {
-				ThrowException(Exception::Error(String::New(error->message)));
+				napi_throw_error(env, NULL, error->message);
 				g_error_free(error);
-				return scope.Close(Undefined());
+				return NULL;
 			}
 		} else {
 			handle = rsvg_handle_new();
 		}
 		// Error handling.
 		if (!handle) {
-			ThrowException(Exception::Error(String::New(
-				"Unable to create RsvgHandle instance."
-			)));
-			return scope.Close(Undefined());
+			napi_throw_error(env, NULL, "Unable to create RsvgHandle instance.");
+			return NULL;
 		}
 		// Create object.
-		Rsvg* obj = new Rsvg(handle);
-		obj->Wrap(args.This());
-		return scope.Close(args.This());
+		Rsvg* obj = new Rsvg(env, handle, ToBoolean(env, args[1]));
+		if (napi_wrap(env, self, obj, Destroy, NULL, NULL) != napi_ok) {
+			delete obj;
+			return NULL;
+		}
+		if (hasData) {
+			obj->ScanElements(data, length, true);
+		}
+		return self;
 	} else {
-		// Invoked as plain function `Rsvg(...)`, turn into construct call.
-		const int argc = 1;
-		Local<Value> argv[argc] = { args[0] };
-		return scope.Close(constructor->NewInstance(argc, argv));
+		// Invoked as plain function `Rsvg(...)`, turn into construct call. The
+		// constructor is the one of the calling thread.
+		rsvg_addon_t* addon = NULL;
+		napi_value constructor;
+		napi_value instance = NULL;
+		napi_get_instance_data(env, reinterpret_cast<void**>(&addon));
+		napi_get_reference_value(env, addon->constructor, &constructor);
+		napi_new_instance(env, constructor, 2, args, &instance);
+		return instance;
 	}
 }
 
-Handle<Value> Rsvg::GetBaseURI(const Arguments& args) {
-	return GetStringProperty(args, "base-uri");
+napi_value Rsvg::GetBaseURI(napi_env env, napi_callback_info info) {
+	return GetStringProperty(env, info, "base-uri");
 }
 
-Handle<Value> Rsvg::SetBaseURI(const Arguments& args) {
-	return SetStringProperty(args, "base-uri");
+napi_value Rsvg::SetBaseURI(napi_env env, napi_callback_info info) {
+	return SetStringProperty(env, info, "base-uri");
 }
 
-Handle<Value> Rsvg::GetDPI(const Arguments& args) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::GetDPI(napi_env env, napi_callback_info info) {
+	Rsvg* obj = Unwrap(env, info, 0, NULL);
+	if (!obj) {
+		return NULL;
+	}
 	gdouble dpiX = 0;
 	gdouble dpiY = 0;
 	g_object_get(
@@ -120,109 +274,124 @@ Handle<Value> Rsvg::GetDPI(const Arguments& args) {
 		NULL
 	);
 
-	Handle<ObjectTemplate> dpi = ObjectTemplate::New();
-	dpi->Set("x", Number::New(dpiX));
-	dpi->Set("y", Number::New(dpiY));
+	napi_value dpi = NewObject(env);
+	SetNamed(env, dpi, "x", NewNumber(env, dpiX));
+	SetNamed(env, dpi, "y", NewNumber(env, dpiY));
 
-	return scope.Close(dpi->NewInstance());
+	return dpi;
 }
 
-Handle<Value> Rsvg::SetDPI(const Arguments& args) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::SetDPI(napi_env env, napi_callback_info info) {
+	napi_value args[2];
+	Rsvg* obj = Unwrap(env, info, 2, args);
+	if (!obj) {
+		return NULL;
+	}
 
-	gdouble x = args[0]->NumberValue();
+	gdouble x = ToNumber(env, args[0]);
 	if (std::isnan(x)) {
 		x = 0;
 	}
 
 	gdouble y = x;
-	if (args[1]->IsNumber()) {
-		y = args[1]->NumberValue();
+	if (IsNumber(env, args[1])) {
+		y = ToNumber(env, args[1]);
 		if (std::isnan(y)) {
 			y = 0;
 		}
 	}
 
 	rsvg_handle_set_dpi_x_y(obj->_handle, x, y);
-	return scope.Close(Undefined());
+	obj->ResetCache();
+	return NULL;
 }
 
-Handle<Value> Rsvg::GetDPIX(const Arguments& args) {
-	return GetNumberProperty(args, "dpi-x");
+napi_value Rsvg::GetDPIX(napi_env env, napi_callback_info info) {
+	return GetNumberProperty(env, info, "dpi-x");
 }
 
-Handle<Value> Rsvg::SetDPIX(const Arguments& args) {
-	return SetNumberProperty(args, "dpi-x");
+napi_value Rsvg::SetDPIX(napi_env env, napi_callback_info info) {
+	return SetNumberProperty(env, info, "dpi-x");
 }
 
-Handle<Value> Rsvg::GetDPIY(const Arguments& args) {
-	return GetNumberProperty(args, "dpi-y");
+napi_value Rsvg::GetDPIY(napi_env env, napi_callback_info info) {
+	return GetNumberProperty(env, info, "dpi-y");
 }
 
-Handle<Value> Rsvg::SetDPIY(const Arguments& args) {
-	return SetNumberProperty(args, "dpi-y");
+napi_value Rsvg::SetDPIY(napi_env env, napi_callback_info info) {
+	return SetNumberProperty(env, info, "dpi-y");
 }
 
-Handle<Value> Rsvg::GetWidth(const Arguments& args) {
-	return GetIntegerProperty(args, "width");
+napi_value Rsvg::GetWidth(napi_env env, napi_callback_info info) {
+	return GetIntegerProperty(env, info, "width");
 }
 
-Handle<Value> Rsvg::GetHeight(const Arguments& args) {
-	return GetIntegerProperty(args, "height");
+napi_value Rsvg::GetHeight(napi_env env, napi_callback_info info) {
+	return GetIntegerProperty(env, info, "height");
 }
 
-Handle<Value> Rsvg::Write(const Arguments& args) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
-	if (Buffer::HasInstance(args[0])) {
-		const guchar* buffer =
-			reinterpret_cast<guchar*>(Buffer::Data(args[0]));
-		gsize length = Buffer::Length(args[0]);
-
+napi_value Rsvg::Write(napi_env env, napi_callback_info info) {
+	napi_value args[1];
+	Rsvg* obj = Unwrap(env, info, 1, args);
+	if (!obj) {
+		return NULL;
+	}
+	char* data = NULL;
+	size_t length = 0;
+	if (GetBufferData(env, args[0], &data, &length)) {
 		GError* error = NULL;
-		gboolean success = rsvg_handle_write(obj->_handle, buffer, length, &error);
+		gboolean success = rsvg_handle_write(
+			obj->_handle, reinterpret_cast<guchar*>(data), length, &error);
+		obj->ScanElements(data, length, false);
+		obj->ResetCache();
 
 		if (error) {
-			ThrowException(Exception::Error(String::New(error->message)));
+			napi_throw_error(env, NULL, error->message);
 			g_error_free(error);
 		} else if (!success) {
-			ThrowException(Exception::Error(String::New("Failed to write data.")));
+			napi_throw_error(env, NULL, "Failed to write data.");
 		}
 	} else {
-		ThrowException(Exception::TypeError(String::New("Invalid argument: buffer")));
+		napi_throw_type_error(env, NULL, "Invalid argument: buffer");
 	}
-	return scope.Close(Undefined());
+	return NULL;
 }
 
-Handle<Value> Rsvg::Close(const Arguments& args) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::Close(napi_env env, napi_callback_info info) {
+	Rsvg* obj = Unwrap(env, info, 0, NULL);
+	if (!obj) {
+		return NULL;
+	}
 
 	GError* error = NULL;
 	gboolean success = rsvg_handle_close(obj->_handle, &error);
+	obj->ScanElements(NULL, 0, true);
+	obj->ResetCache();
 
 	if (error) {
-		ThrowException(Exception::Error(String::New(error->message)));
+		napi_throw_error(env, NULL, error->message);
 		g_error_free(error);
 	} else if (!success) {
-		ThrowException(Exception::Error(String::New("Failed to close.")));
+		napi_throw_error(env, NULL, "Failed to close.");
 	}
-	return scope.Close(Undefined());
+	return NULL;
 }
 
-Handle<Value> Rsvg::Dimensions(const Arguments& args) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::Dimensions(napi_env env, napi_callback_info info) {
+	napi_value args[1];
+	Rsvg* obj = Unwrap(env, info, 1, args);
+	if (!obj) {
+		return NULL;
+	}
 
 	const char* id = NULL;
-	String::Utf8Value idArg(args[0]);
-	if (!(args[0]->IsUndefined() || args[0]->IsNull())) {
-		id = *idArg;
-		if (!id) {
-			ThrowException(Exception::TypeError(String::New("Invalid argument: id")));
-			return scope.Close(Undefined());
+	std::string idArg;
+	if (!IsNullish(env, args[0])) {
+		if (!ToUtf8(env, args[0], &idArg)) {
+			napi_throw_type_error(env, NULL, "Invalid argument: id");
+			return NULL;
 		}
+		id = idArg.c_str();
 	}
 
 	RsvgPositionData _position = { 0, 0 };
@@ -232,94 +401,157 @@ Handle<Value> Rsvg::Dimensions(const Arguments& args) {
 	gboolean hasDimensions = rsvg_handle_get_dimensions_sub(obj->_handle, &_dimensions, id);
 
 	if (hasPosition || hasDimensions) {
-		Handle<ObjectTemplate> dimensions = ObjectTemplate::New();
+		napi_value dimensions = NewObject(env);
 		if (hasPosition) {
-			dimensions->Set("x", Integer::New(_position.x));
-			dimensions->Set("y", Integer::New(_position.y));
+			SetNamed(env, dimensions, "x", NewInteger(env, _position.x));
+			SetNamed(env, dimensions, "y", NewInteger(env, _position.y));
 		}
 		if (hasDimensions) {
-			dimensions->Set("width", Integer::New(_dimensions.width));
-			dimensions->Set("height", Integer::New(_dimensions.height));
+			SetNamed(env, dimensions, "width", NewInteger(env, _dimensions.width));
+			SetNamed(env, dimensions, "height", NewInteger(env, _dimensions.height));
 		}
-		return scope.Close(dimensions->NewInstance());
+		return dimensions;
 	} else {
-		return scope.Close(Null());
+		return Null(env);
 	}
 }
 
-Handle<Value> Rsvg::HasElement(const Arguments& args) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::HasElement(napi_env env, napi_callback_info info) {
+	napi_value args[1];
+	Rsvg* obj = Unwrap(env, info, 1, args);
+	if (!obj) {
+		return NULL;
+	}
 
 	const char* id = NULL;
-	String::Utf8Value idArg(args[0]);
-	if (!(args[0]->IsUndefined() || args[0]->IsNull())) {
-		id = *idArg;
-		if (!id) {
-			ThrowException(Exception::TypeError(String::New("Invalid argument: id")));
-			return scope.Close(Undefined());
+	std::string idArg;
+	if (!IsNullish(env, args[0])) {
+		if (!ToUtf8(env, args[0], &idArg)) {
+			napi_throw_type_error(env, NULL, "Invalid argument: id");
+			return NULL;
 		}
+		id = idArg.c_str();
 	}
 
 	gboolean exists = rsvg_handle_has_sub(obj->_handle, id);
-	return scope.Close(Boolean::New(exists));
+	return NewBoolean(env, exists);
 }
 
-Handle<Value> Rsvg::Render(const Arguments& args) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::Render(napi_env env, napi_callback_info info) {
+	napi_value args[5];
+	Rsvg* obj = Unwrap(env, info, 5, args);
+	if (!obj) {
+		return NULL;
+	}
 
-	int width = args[0]->Int32Value();
-	int height = args[1]->Int32Value();
+	int width = ToInt32(env, args[0]);
+	int height = ToInt32(env, args[1]);
 
 	if (width <= 0) {
-		ThrowException(Exception::RangeError(String::New("Expected width > 0.")));
-		return scope.Close(Undefined());
+		napi_throw_range_error(env, NULL, "Expected width > 0.");
+		return NULL;
 	}
 	if (height <= 0) {
-		ThrowException(Exception::RangeError(String::New("Expected height > 0.")));
-		return scope.Close(Undefined());
+		napi_throw_range_error(env, NULL, "Expected height > 0.");
+		return NULL;
 	}
 
-	String::Utf8Value formatArg(args[2]);
-	const char* formatString = *formatArg;
+	std::string formatArg;
+	const char* formatString = ToUtf8(env, args[2], &formatArg) ? formatArg.c_str() : NULL;
 	render_format_t renderFormat = RenderFormatFromString(formatString);
 	cairo_format_t pixelFormat = CAIRO_FORMAT_INVALID;
 	if (renderFormat == RENDER_FORMAT_RAW ||
-			renderFormat == RENDER_FORMAT_PNG) {
+			renderFormat == RENDER_FORMAT_PNG ||
+			renderFormat == RENDER_FORMAT_PNG8) {
 		pixelFormat = CAIRO_FORMAT_ARGB32;
 	} else if (renderFormat == RENDER_FORMAT_JPEG) {
-		ThrowException(Exception::Error(String::New("Format not supported: JPEG")));
-		return scope.Close(Undefined());
+		napi_throw_error(env, NULL, "Format not supported: JPEG");
+		return NULL;
 	} else if (
 			renderFormat == RENDER_FORMAT_SVG ||
 			renderFormat == RENDER_FORMAT_PDF) {
 		pixelFormat = CAIRO_FORMAT_INVALID;
 	} else if (renderFormat == RENDER_FORMAT_VIPS) {
-		ThrowException(Exception::Error(String::New("Format not supported: VIPS")));
-		return scope.Close(Undefined());
+		napi_throw_error(env, NULL, "Format not supported: VIPS");
+		return NULL;
 	} else {
 		renderFormat = RENDER_FORMAT_RAW;
 		pixelFormat = CairoFormatFromString(formatString);
 		if (pixelFormat == CAIRO_FORMAT_INVALID) {
-			ThrowException(Exception::RangeError(String::New("Invalid argument: format")));
-			return scope.Close(Undefined());
+			napi_throw_range_error(env, NULL, "Invalid argument: format");
+			return NULL;
+		}
+	}
+
+	bool dither = false;
+	bool record = false;
+	bool draft = false;
+	double resolution = 1;
+	if (IsObject(env, args[4])) {
+		napi_value options = args[4];
+		dither = ToBoolean(env, GetNamed(env, options, "dither"));
+		record = ToBoolean(env, GetNamed(env, options, "record"));
+		std::string quality;
+		draft = ToUtf8(env, GetNamed(env, options, "quality"), &quality) && quality == "draft";
+		napi_value resolutionArg = GetNamed(env, options, "resolution");
+		if (draft) {
+			resolution = DRAFT_RESOLUTION;
+		}
+		if (draft && IsNumber(env, resolutionArg)) {
+			resolution = ToNumber(env, resolutionArg);
+			if (!(resolution > 0 && resolution <= 1)) {
+				napi_throw_range_error(env, NULL, "Expected 0 < resolution <= 1.");
+				return NULL;
+			}
+		}
+	}
+
+	// Draft renders in reduced resolution are drawn on a smaller surface first,
+	// which also applies to replayed recordings.
+	int draftWidth = width;
+	int draftHeight = height;
+	if (pixelFormat != CAIRO_FORMAT_INVALID && resolution < 1) {
+		draftWidth = MAX(1, int(ceil(width * resolution)));
+		draftHeight = MAX(1, int(ceil(height * resolution)));
+	}
+
+	// Raster renders hold the surface and the resulting buffer, and for encoded
+	// formats the encoded data in between. Palette images also need memory
+	// for quantizing the colors.
+	RenderReservation reservation;
+	if (pixelFormat != CAIRO_FORMAT_INVALID) {
+		int stride = cairo_format_stride_for_width(pixelFormat, width);
+		int draftStride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, draftWidth);
+		if (stride < 0 || draftStride < 0 || !CheckRenderPixels(int64_t(width) * height)) {
+			napi_throw_range_error(env, "ERR_RSVG_PIXEL_LIMIT",
+				"Render exceeds the maximum number of pixels.");
+			return NULL;
+		}
+		int64_t surfaceBytes = int64_t(stride) * height;
+		int64_t draftBytes = (draftWidth != width || draftHeight != height) ?
+			int64_t(draftStride) * draftHeight : 0;
+		int64_t bytes = surfaceBytes * (renderFormat == RENDER_FORMAT_RAW ? 2 : 3) + draftBytes;
+		if (renderFormat == RENDER_FORMAT_PNG8) {
+			bytes += PalettePNGBytes(width, height);
+		}
+		if (!reservation.Acquire(bytes)) {
+			napi_throw_range_error(env, "ERR_RSVG_MEMORY_LIMIT",
+				"Render exceeds the memory available for renders.");
+			return NULL;
 		}
 	}
 
 	const char* id = NULL;
-	String::Utf8Value idArg(args[3]);
-	if (!(args[3]->IsUndefined() || args[3]->IsNull())) {
-		id = *idArg;
-		if (!id) {
-			ThrowException(Exception::TypeError(String::New("Invalid argument: id")));
-			return scope.Close(Undefined());
+	std::string idArg;
+	if (!IsNullish(env, args[3])) {
+		if (!ToUtf8(env, args[3], &idArg)) {
+			napi_throw_type_error(env, NULL, "Invalid argument: id");
+			return NULL;
 		}
+		id = idArg.c_str();
 		if (!rsvg_handle_has_sub(obj->_handle, id)) {
-			ThrowException(Exception::RangeError(String::New(
-				"SVG element with given id does not exists."
-			)));
-			return scope.Close(Undefined());
+			napi_throw_range_error(env, NULL, "SVG element with given id does not exists.");
+			return NULL;
 		}
 	}
 
@@ -327,23 +559,17 @@ Handle<Value> Rsvg::Render(const Arguments& args) {
 	RsvgDimensionData dimensions = { 0, 0, 0, 0 };
 
 	if (!rsvg_handle_get_position_sub(obj->_handle, &position, id)) {
-		ThrowException(Exception::Error(String::New(
-			"Could not get position of SVG element with given id."
-		)));
-		return scope.Close(Undefined());
+		napi_throw_error(env, NULL, "Could not get position of SVG element with given id.");
+		return NULL;
 	}
 
 	if (!rsvg_handle_get_dimensions_sub(obj->_handle, &dimensions, id)) {
-		ThrowException(Exception::Error(String::New(
-			"Could not get dimensions of SVG element or whole image."
-		)));
-		return scope.Close(Undefined());
+		napi_throw_error(env, NULL, "Could not get dimensions of SVG element or whole image.");
+		return NULL;
 	}
 	if (dimensions.width <= 0 || dimensions.height <= 0) {
-		ThrowException(Exception::Error(String::New(
-			"Got invalid dimensions of SVG element or whole image."
-		)));
-		return scope.Close(Undefined());
+		napi_throw_error(env, NULL, "Got invalid dimensions of SVG element or whole image.");
+		return NULL;
 	}
 
 	std::string data;
@@ -361,7 +587,19 @@ Handle<Value> Rsvg::Render(const Arguments& args) {
 		surface = cairo_image_surface_create(pixelFormat, width, height);
 	}
 
-	cairo_t* cr = cairo_create(surface);
+	cairo_surface_t* draftSurface = NULL;
+	if (draftWidth != width || draftHeight != height) {
+		draftSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, draftWidth, draftHeight);
+	}
+
+	cairo_t* cr = cairo_create(draftSurface ? draftSurface : surface);
+	if (draftSurface) {
+		cairo_scale(cr, double(draftWidth) / width, double(draftHeight) / height);
+	}
+	if (draft) {
+		// Recordings keep the tolerance they were recorded with.
+		cairo_set_tolerance(cr, DRAFT_TOLERANCE);
+	}
 	// printf(
 	// 	"%s: (%d, %d) %dx%d, render: %dx%d\n",
 	// 	id ? id : "SVG",
@@ -386,123 +624,190 @@ Handle<Value> Rsvg::Render(const Arguments& args) {
 	cairo_translate(cr, -position.x, -position.y);
 
 	gboolean success;
-	if (id) {
+	cairo_surface_t* recording = record ? obj->Recording(id) : NULL;
+	if (recording) {
+		cairo_set_source_surface(cr, recording, 0, 0);
+		cairo_paint(cr);
+		success = TRUE;
+	} else if (id) {
 		success = rsvg_handle_render_cairo_sub(obj->_handle, cr, id);
 	} else {
 		success = rsvg_handle_render_cairo(obj->_handle, cr);
 	}
-	cairo_surface_flush(surface);
+	cairo_surface_flush(draftSurface ? draftSurface : surface);
 
 	cairo_status_t status = cairo_status(cr);
 	if (status || !success) {
 		cairo_destroy(cr);
 		cairo_surface_destroy(surface);
+		if (draftSurface) {
+			cairo_surface_destroy(draftSurface);
+		}
 
-		ThrowException(Exception::Error(String::New(
-			status ? cairo_status_to_string(status) : "Failed to render image."
-		)));
-		return scope.Close(Undefined());
+		napi_throw_error(env, NULL,
+			status ? cairo_status_to_string(status) : "Failed to render image.");
+		return NULL;
+	}
+
+	if (draftSurface) {
+		// Cheap upscale of the draft to the requested size.
+		cairo_destroy(cr);
+		cr = cairo_create(surface);
+		cairo_scale(cr, double(width) / draftWidth, double(height) / draftHeight);
+		cairo_set_source_surface(cr, draftSurface, 0, 0);
+		cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BILINEAR);
+		// Repeat the edge pixels, otherwise the filter fades the border.
+		cairo_pattern_set_extend(cairo_get_source(cr), CAIRO_EXTEND_PAD);
+		cairo_paint(cr);
+		cairo_surface_flush(surface);
+		cairo_surface_destroy(draftSurface);
 	}
 
 	int stride = -1;
+	napi_value buffer = NULL;
 	if (renderFormat == RENDER_FORMAT_RAW) {
+		// Copy straight from the surface, without an intermediate string.
 		stride = cairo_image_surface_get_stride(surface);
-		data.append(
-			reinterpret_cast<char*>(cairo_image_surface_get_data(surface)),
-			stride * height
-		);
+		buffer = NewBuffer(env, cairo_image_surface_get_data(surface), size_t(stride) * height);
 	} else if (renderFormat == RENDER_FORMAT_PNG) {
 		cairo_surface_write_to_png_stream(surface, GetDataChunks, &data);
+	} else if (renderFormat == RENDER_FORMAT_PNG8) {
+		success = WritePalettePNG(surface, &data, dither);
 	}
 
 	cairo_destroy(cr);
 	cairo_surface_destroy(surface);
 
+	if (!success) {
+		napi_throw_error(env, NULL, "Failed to encode image.");
+		return NULL;
+	}
+
 	if (renderFormat == RENDER_FORMAT_RAW &&
 			pixelFormat == CAIRO_FORMAT_ARGB32 &&
 			stride != width * 4) {
-		ThrowException(Exception::Error(String::New(
-			"Rendered with invalid stride (byte size of row) for ARGB32 format."
-		)));
-		return scope.Close(Undefined());
+		napi_throw_error(env, NULL,
+			"Rendered with invalid stride (byte size of row) for ARGB32 format.");
+		return NULL;
 	}
 
-	Handle<ObjectTemplate> image = ObjectTemplate::New();
+	napi_value image = NewObject(env);
 	if (renderFormat == RENDER_FORMAT_SVG) {
-		image->Set("data", String::New(data.c_str()));
+		SetNamed(env, image, "data", NewString(env, data.c_str(), data.length()));
+	} else if (renderFormat == RENDER_FORMAT_RAW) {
+		SetNamed(env, image, "data", buffer);
 	} else {
-		image->Set("data", Buffer::New(data.c_str(), data.length())->handle_);
+		SetNamed(env, image, "data", NewBuffer(env, data.c_str(), data.length()));
 	}
 
-	image->Set("format", RenderFormatToString(renderFormat));
+	SetNamed(env, image, "format", RenderFormatToString(env, renderFormat));
 	if (pixelFormat != CAIRO_FORMAT_INVALID) {
-		image->Set("pixelFormat", CairoFormatToString(pixelFormat));
+		SetNamed(env, image, "pixelFormat", CairoFormatToString(env, pixelFormat));
 	}
-	image->Set("width", Integer::New(width));
-	image->Set("height", Integer::New(height));
+	SetNamed(env, image, "width", NewInteger(env, width));
+	SetNamed(env, image, "height", NewInteger(env, height));
 	if (stride != -1) {
-		image->Set("stride", Integer::New(stride));
+		SetNamed(env, image, "stride", NewInteger(env, stride));
 	}
-	return scope.Close(image->NewInstance());
+	return image;
+}
+
+napi_value Rsvg::SetLimits(napi_env env, napi_callback_info info) {
+	size_t argc = 2;
+	napi_value args[2];
+	napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+	SetRenderLimits(ToInt64(env, args[0]), ToInt64(env, args[1]));
+	return NULL;
 }
 
-Handle<Value> Rsvg::GetStringProperty(const Arguments& args, const char* property) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::Usage(napi_env env, napi_callback_info info) {
+	render_limits_t limits = GetRenderLimits();
+
+	napi_value usage = NewObject(env);
+	SetNamed(env, usage, "maxPixels", NewNumber(env, double(limits.maxPixels)));
+	SetNamed(env, usage, "maxBytes", NewNumber(env, double(limits.maxBytes)));
+	SetNamed(env, usage, "bytes", NewNumber(env, double(limits.bytes)));
+	SetNamed(env, usage, "renders", NewInteger(env, limits.renders));
+	return usage;
+}
+
+napi_value Rsvg::GetStringProperty(napi_env env, napi_callback_info info, const char* property) {
+	Rsvg* obj = Unwrap(env, info, 0, NULL);
+	if (!obj) {
+		return NULL;
+	}
 	gchar* value = NULL;
 	g_object_get(G_OBJECT(obj->_handle), property, &value, NULL);
-	Handle<Value> result(value ? String::New(value) : Null());
+	napi_value result = value ? NewString(env, value) : Null(env);
 	if (value) {
 		g_free(value);
 	}
-	return scope.Close(result);
+	return result;
 }
 
-Handle<Value> Rsvg::SetStringProperty(const Arguments& args, const char* property) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
-	gchar* value = NULL;
-	String::Utf8Value arg0(args[0]);
-	if (!(args[0]->IsNull() || args[0]->IsUndefined())) {
-		value = *arg0;
+napi_value Rsvg::SetStringProperty(napi_env env, napi_callback_info info, const char* property) {
+	napi_value args[1];
+	Rsvg* obj = Unwrap(env, info, 1, args);
+	if (!obj) {
+		return NULL;
+	}
+	const gchar* value = NULL;
+	std::string arg0;
+	if (!IsNullish(env, args[0]) && ToUtf8(env, args[0], &arg0)) {
+		value = arg0.c_str();
 	}
 	g_object_set(G_OBJECT(obj->_handle), property, value, NULL);
-	return scope.Close(Undefined());
+	obj->ResetCache();
+	return NULL;
 }
 
-Handle<Value> Rsvg::GetNumberProperty(const Arguments& args, const char* property) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::GetNumberProperty(napi_env env, napi_callback_info info, const char* property) {
+	Rsvg* obj = Unwrap(env, info, 0, NULL);
+	if (!obj) {
+		return NULL;
+	}
 	gdouble value = 0;
 	g_object_get(G_OBJECT(obj->_handle), property, &value, NULL);
-	return scope.Close(Number::New(value));
+	return NewNumber(env, value);
 }
 
-Handle<Value> Rsvg::SetNumberProperty(const Arguments& args, const char* property) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
-	gdouble value = args[0]->NumberValue();
+napi_value Rsvg::SetNumberProperty(napi_env env, napi_callback_info info, const char* property) {
+	napi_value args[1];
+	Rsvg* obj = Unwrap(env, info, 1, args);
+	if (!obj) {
+		return NULL;
+	}
+	gdouble value = ToNumber(env, args[0]);
 	if (std::isnan(value)) {
 		value = 0;
 	}
 	g_object_set(G_OBJECT(obj->_handle), property, value, NULL);
-	return scope.Close(Undefined());
+	obj->ResetCache();
+	return NULL;
 }
 
-Handle<Value> Rsvg::GetIntegerProperty(const Arguments& args, const char* property) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
+napi_value Rsvg::GetIntegerProperty(napi_env env, napi_callback_info info, const char* property) {
+	Rsvg* obj = Unwrap(env, info, 0, NULL);
+	if (!obj) {
+		return NULL;
+	}
 	gint value = 0;
 	g_object_get(G_OBJECT(obj->_handle), property, &value, NULL);
-	return scope.Close(Integer::New(value));
+	return NewInteger(env, value);
 }
 
-Handle<Value> Rsvg::SetIntegerProperty(const Arguments& args, const char* property) {
-	HandleScope scope;
-	Rsvg* obj = ObjectWrap::Unwrap<Rsvg>(args.This());
-	gint value = args[0]->Int32Value();
+napi_value Rsvg::SetIntegerProperty(napi_env env, napi_callback_info info, const char* property) {
+	napi_value args[1];
+	Rsvg* obj = Unwrap(env, info, 1, args);
+	if (!obj) {
+		return NULL;
+	}
+	gint value = ToInt32(env, args[0]);
 	g_object_set(G_OBJECT(obj->_handle), property, value, NULL);
-	return scope.Close(Undefined());
+	obj->ResetCache();
+	return NULL;
 }
 
-NODE_MODULE(rsvg, Rsvg::Init)
+// N-API addons can be loaded by several threads (eg. worker threads), each
+// getting their own exports.
+NAPI_MODULE(rsvg, Rsvg::Init)
@@ -1,42 +1,77 @@
 #ifndef __RSVG_H__
 #define __RSVG_H__
 
-#include <node.h>
+#include <node_api.h>
 #include <librsvg/rsvg.h>
+#include <libxml/parser.h>
+#include <cairo.h>
+#include <map>
+#include <string>
+#include <vector>
 
-class Rsvg : public node::ObjectWrap {
+struct element_id_t {
+	std::string id;
+	std::string type;
+};
+
+struct recording_t {
+	cairo_surface_t* surface;
+	unsigned long used;
+};
+
+class Rsvg {
 public:
-	static void Init(v8::Handle<v8::Object> exports);
+	static napi_value Init(napi_env env, napi_value exports);
 
 private:
-	explicit Rsvg(RsvgHandle* const handle);
+	Rsvg(napi_env env, RsvgHandle* const handle, bool indexElements);
 	~Rsvg();
 
-	static v8::Handle<v8::Value> New(const v8::Arguments& args);
-	static v8::Handle<v8::Value> GetBaseURI(const v8::Arguments& args);
-	static v8::Handle<v8::Value> SetBaseURI(const v8::Arguments& args);
-	static v8::Handle<v8::Value> GetDPI(const v8::Arguments& args);
-	static v8::Handle<v8::Value> SetDPI(const v8::Arguments& args);
-	static v8::Handle<v8::Value> GetDPIX(const v8::Arguments& args);
-	static v8::Handle<v8::Value> SetDPIX(const v8::Arguments& args);
-	static v8::Handle<v8::Value> GetDPIY(const v8::Arguments& args);
-	static v8::Handle<v8::Value> SetDPIY(const v8::Arguments& args);
-	static v8::Handle<v8::Value> GetWidth(const v8::Arguments& args);
-	static v8::Handle<v8::Value> GetHeight(const v8::Arguments& args);
-	static v8::Handle<v8::Value> Write(const v8::Arguments& args);
-	static v8::Handle<v8::Value> Close(const v8::Arguments& args);
-	static v8::Handle<v8::Value> Dimensions(const v8::Arguments& args);
-	static v8::Handle<v8::Value> HasElement(const v8::Arguments& args);
-	static v8::Handle<v8::Value> Autocrop(const v8::Arguments& args);
-	static v8::Handle<v8::Value> Render(const v8::Arguments& args);
-	static v8::Handle<v8::Value> GetStringProperty(const v8::Arguments& args, const char* property);
-	static v8::Handle<v8::Value> SetStringProperty(const v8::Arguments& args, const char* property);
-	static v8::Handle<v8::Value> GetNumberProperty(const v8::Arguments& args, const char* property);
-	static v8::Handle<v8::Value> SetNumberProperty(const v8::Arguments& args, const char* property);
-	static v8::Handle<v8::Value> GetIntegerProperty(const v8::Arguments& args, const char* property);
-	static v8::Handle<v8::Value> SetIntegerProperty(const v8::Arguments& args, const char* property);
-	static v8::Persistent<v8::Function> constructor;
+	static void InitParsers();
+	static void InitScanHandler();
+	static void InitProbe();
+	static void Destroy(napi_env env, void* data, void* hint);
+	static Rsvg* Unwrap(napi_env env, napi_callback_info info, size_t argc, napi_value* args);
+	static napi_value New(napi_env env, napi_callback_info info);
+	static napi_value GetBaseURI(napi_env env, napi_callback_info info);
+	static napi_value SetBaseURI(napi_env env, napi_callback_info info);
+	static napi_value GetDPI(napi_env env, napi_callback_info info);
+	static napi_value SetDPI(napi_env env, napi_callback_info info);
+	static napi_value GetDPIX(napi_env env, napi_callback_info info);
+	static napi_value SetDPIX(napi_env env, napi_callback_info info);
+	static napi_value GetDPIY(napi_env env, napi_callback_info info);
+	static napi_value SetDPIY(napi_env env, napi_callback_info info);
+	static napi_value GetWidth(napi_env env, napi_callback_info info);
+	static napi_value GetHeight(napi_env env, napi_callback_info info);
+	static napi_value Write(napi_env env, napi_callback_info info);
+	static napi_value Close(napi_env env, napi_callback_info info);
+	static napi_value Dimensions(napi_env env, napi_callback_info info);
+	static napi_value HasElement(napi_env env, napi_callback_info info);
+	static napi_value Elements(napi_env env, napi_callback_info info);
+	static napi_value Autocrop(napi_env env, napi_callback_info info);
+	static napi_value Render(napi_env env, napi_callback_info info);
+	static napi_value Probe(napi_env env, napi_callback_info info);
+	static napi_value Compare(napi_env env, napi_callback_info info);
+	static napi_value SetLimits(napi_env env, napi_callback_info info);
+	static napi_value Usage(napi_env env, napi_callback_info info);
+	static napi_value GetStringProperty(napi_env env, napi_callback_info info, const char* property);
+	static napi_value SetStringProperty(napi_env env, napi_callback_info info, const char* property);
+	static napi_value GetNumberProperty(napi_env env, napi_callback_info info, const char* property);
+	static napi_value SetNumberProperty(napi_env env, napi_callback_info info, const char* property);
+	static napi_value GetIntegerProperty(napi_env env, napi_callback_info info, const char* property);
+	static napi_value SetIntegerProperty(napi_env env, napi_callback_info info, const char* property);
+	void ScanElements(const char* data, size_t length, bool terminate);
+	void ResetCache();
+	cairo_surface_t* Recording(const char* id);
+	napi_env const _env;
 	RsvgHandle* const _handle;
+	bool const _indexElements;
+	xmlParserCtxtPtr _scanner;
+	bool _scanned;
+	std::vector<element_id_t> _ids;
+	napi_ref _elements;
+	std::map<std::string, recording_t> _recordings;
+	unsigned long _recordingUses;
 };
 
-#endif /*__RSVG_H__*/
\ No newline at end of file
+#endif /*__RSVG_H__*/
@@ -0,0 +1,148 @@
+#include "Values.h"
+#include <cmath>
+
+napi_value Undefined(napi_env env) {
+	napi_value result = NULL;
+	napi_get_undefined(env, &result);
+	return result;
+}
+
+napi_value Null(napi_env env) {
+	napi_value result = NULL;
+	napi_get_null(env, &result);
+	return result;
+}
+
+napi_value NewBoolean(napi_env env, bool value) {
+	napi_value result = NULL;
+	napi_get_boolean(env, value, &result);
+	return result;
+}
+
+napi_value NewInteger(napi_env env, int32_t value) {
+	napi_value result = NULL;
+	napi_create_int32(env, value, &result);
+	return result;
+}
+
+napi_value NewNumber(napi_env env, double value) {
+	napi_value result = NULL;
+	napi_create_double(env, value, &result);
+	return result;
+}
+
+napi_value NewString(napi_env env, const char* value, size_t length) {
+	napi_value result = NULL;
+	napi_create_string_utf8(env, value, length, &result);
+	return result;
+}
+
+napi_value NewObject(napi_env env) {
+	napi_value result = NULL;
+	napi_create_object(env, &result);
+	return result;
+}
+
+napi_value NewArray(napi_env env) {
+	napi_value result = NULL;
+	napi_create_array(env, &result);
+	return result;
+}
+
+napi_value NewBuffer(napi_env env, const void* data, size_t length) {
+	napi_value result = NULL;
+	napi_create_buffer_copy(env, length, data, NULL, &result);
+	return result;
+}
+
+napi_value GetNamed(napi_env env, napi_value object, const char* name) {
+	napi_value result = NULL;
+	if (napi_get_named_property(env, object, name, &result) != napi_ok) {
+		return Undefined(env);
+	}
+	return result;
+}
+
+void SetNamed(napi_env env, napi_value object, const char* name, napi_value value) {
+	napi_set_named_property(env, object, name, value);
+}
+
+bool IsNullish(napi_env env, napi_value value) {
+	napi_valuetype type = napi_undefined;
+	napi_typeof(env, value, &type);
+	return type == napi_undefined || type == napi_null;
+}
+
+bool IsObject(napi_env env, napi_value value) {
+	napi_valuetype type = napi_undefined;
+	napi_typeof(env, value, &type);
+	return type == napi_object || type == napi_function;
+}
+
+bool IsNumber(napi_env env, napi_value value) {
+	napi_valuetype type = napi_undefined;
+	napi_typeof(env, value, &type);
+	return type == napi_number;
+}
+
+bool GetBufferData(napi_env env, napi_value value, char** data, size_t* length) {
+	bool isBuffer = false;
+	if (napi_is_buffer(env, value, &isBuffer) != napi_ok || !isBuffer) {
+		return false;
+	}
+	void* bytes = NULL;
+	if (napi_get_buffer_info(env, value, &bytes, length) != napi_ok) {
+		return false;
+	}
+	*data = reinterpret_cast<char*>(bytes);
+	return true;
+}
+
+bool ToBoolean(napi_env env, napi_value value) {
+	napi_value coerced;
+	bool result = false;
+	if (napi_coerce_to_bool(env, value, &coerced) == napi_ok) {
+		napi_get_value_bool(env, coerced, &result);
+	}
+	return result;
+}
+
+int32_t ToInt32(napi_env env, napi_value value) {
+	napi_value coerced;
+	int32_t result = 0;
+	if (napi_coerce_to_number(env, value, &coerced) == napi_ok) {
+		napi_get_value_int32(env, coerced, &result);
+	}
+	return result;
+}
+
+int64_t ToInt64(napi_env env, napi_value value) {
+	napi_value coerced;
+	int64_t result = 0;
+	if (napi_coerce_to_number(env, value, &coerced) == napi_ok) {
+		napi_get_value_int64(env, coerced, &result);
+	}
+	return result;
+}
+
+double ToNumber(napi_env env, napi_value value) {
+	napi_value coerced;
+	double result = NAN;
+	if (napi_coerce_to_number(env, value, &coerced) == napi_ok) {
+		napi_get_value_double(env, coerced, &result);
+	}
+	return result;
+}
+
+bool ToUtf8(napi_env env, napi_value value, std::string* result) {
+	napi_value coerced;
+	size_t length = 0;
+	if (napi_coerce_to_string(env, value, &coerced) != napi_ok ||
+			napi_get_value_string_utf8(env, coerced, NULL, 0, &length) != napi_ok) {
+		return false;
+	}
+	result->resize(length + 1);
+	napi_get_value_string_utf8(env, coerced, &(*result)[0], length + 1, &length);
+	result->resize(length);
+	return true;
+}
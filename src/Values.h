@@ -0,0 +1,34 @@
+#ifndef __VALUES_H__
+#define __VALUES_H__
+
+#include <node_api.h>
+#include <stdint.h>
+#include <string>
+
+// Helpers for creating and reading JavaScript values. Conversions follow the
+// JavaScript rules, so eg. `undefined` becomes 0 and NaN becomes 0 for integers.
+napi_value Undefined(napi_env env);
+napi_value Null(napi_env env);
+napi_value NewBoolean(napi_env env, bool value);
+napi_value NewInteger(napi_env env, int32_t value);
+napi_value NewNumber(napi_env env, double value);
+napi_value NewString(napi_env env, const char* value, size_t length = NAPI_AUTO_LENGTH);
+napi_value NewObject(napi_env env);
+napi_value NewArray(napi_env env);
+napi_value NewBuffer(napi_env env, const void* data, size_t length);
+
+napi_value GetNamed(napi_env env, napi_value object, const char* name);
+void SetNamed(napi_env env, napi_value object, const char* name, napi_value value);
+
+bool IsNullish(napi_env env, napi_value value);
+bool IsObject(napi_env env, napi_value value);
+bool IsNumber(napi_env env, napi_value value);
+bool GetBufferData(napi_env env, napi_value value, char** data, size_t* length);
+
+bool ToBoolean(napi_env env, napi_value value);
+int32_t ToInt32(napi_env env, napi_value value);
+int64_t ToInt64(napi_env env, napi_value value);
+double ToNumber(napi_env env, napi_value value);
+bool ToUtf8(napi_env env, napi_value value, std::string* result);
+
+#endif /*__VALUES_H__*/
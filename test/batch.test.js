@@ -0,0 +1,206 @@
+'use strict';
+
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+var childProcess = require('child_process');
+var batch = require('../bin/rsvg-batch');
+
+var cli = path.join(__dirname, '..', 'bin', 'rsvg-batch.js');
+var svg = '<svg width="4" height="2"><rect width="2" height="2"/></svg>';
+
+function removeTree(file) {
+	if (fs.statSync(file).isDirectory()) {
+		fs.readdirSync(file).forEach(function(name) {
+			removeTree(path.join(file, name));
+		});
+		fs.rmdirSync(file);
+	} else {
+		fs.unlinkSync(file);
+	}
+}
+
+describe('rsvg-batch', function() {
+	var dir;
+
+	function write(name, data) {
+		var file = path.join(dir, name);
+		name.split('/').slice(0, -1).reduce(function(parent, part) {
+			var child = path.join(parent, part);
+			if (!fs.existsSync(child)) {
+				fs.mkdirSync(child);
+			}
+			return child;
+		}, dir);
+		fs.writeFileSync(file, data || svg);
+		return file;
+	}
+
+	function run(args, callback) {
+		childProcess.execFile(process.execPath, args, function(error, stdout) {
+			callback(error, stdout.trim().split('\n').pop());
+		});
+	}
+
+	beforeEach(function() {
+		dir = fs.mkdtempSync(path.join(os.tmpdir(), 'rsvg-batch-'));
+	});
+
+	afterEach(function() {
+		removeTree(dir);
+	});
+
+	describe('globToRegExp()', function() {
+		it('matches "*", "?" and "**"', function() {
+			var pattern = batch.globToRegExp('icons/**/*.svg');
+			pattern.test('icons/a.svg').should.be.true;
+			pattern.test('icons/x/y/a.svg').should.be.true;
+			pattern.test('icons/a.png').should.be.false;
+			pattern.test('other/a.svg').should.be.false;
+			batch.globToRegExp('?.svg').test('a.svg').should.be.true;
+			batch.globToRegExp('?.svg').test('ab.svg').should.be.false;
+			batch.globToRegExp('a+(1).svg').test('a+(1).svg').should.be.true;
+		});
+	});
+
+	describe('globDirTest()', function() {
+		it('only descends where the pattern can match', function() {
+			var test = batch.globDirTest('*.svg');
+			test('node_modules').should.be.false;
+
+			test = batch.globDirTest('a*/b/*.svg');
+			test('ab').should.be.true;
+			test('ab/b').should.be.true;
+			test('ab/c').should.be.false;
+			test('ab/b/c').should.be.false;
+			test('x').should.be.false;
+
+			test = batch.globDirTest('a*/**/*.svg');
+			test('ab/c/d').should.be.true;
+			test('x/c').should.be.false;
+		});
+	});
+
+	describe('InputWalker', function() {
+		it('lists SVG files of directories and glob patterns', function(done) {
+			write('a.svg');
+			write('b.txt');
+			write('sub/c.svg');
+			write('sub/deep/d.svg');
+			write('other/e.svg');
+
+			var walker = new batch.InputWalker([
+				path.join(dir, 'sub'),
+				path.join(dir, 'other', '*.svg')
+			]);
+			var found = [];
+			(function next() {
+				walker.next(function(error, file) {
+					if (error || !file) {
+						found.should.deep.equal([
+							'c.svg',
+							path.join('deep', 'd.svg'),
+							'e.svg'
+						]);
+						return done(error);
+					}
+					found.push(file.relative);
+					next();
+				});
+			})();
+		});
+	});
+
+	describe('outputsFor()', function() {
+		var file = { path: path.join('in', 'sub', 'a.svg'), relative: 'sub/a.svg' };
+
+		it('puts outputs next to the input by default', function() {
+			var options = batch.parseArgs(['-f', 'png,pdf', 'in']);
+			batch.outputsFor(file, options).map(function(output) {
+				return output.path;
+			}).should.deep.equal([
+				path.join('in', 'sub', 'a.png'),
+				path.join('in', 'sub', 'a.pdf')
+			]);
+		});
+
+		it('keeps the directories below the output directory', function() {
+			var options = batch.parseArgs(['-o', 'out', '-s', '8x8,16x16', 'in']);
+			batch.outputsFor(file, options).map(function(output) {
+				return output.path;
+			}).should.deep.equal([
+				path.join('out', 'sub', 'a-8x8.png'),
+				path.join('out', 'sub', 'a-16x16.png')
+			]);
+		});
+
+		it('names png8 images apart from png images', function() {
+			var options = batch.parseArgs(['-f', 'png,png8', 'in']);
+			batch.outputsFor(file, options).map(function(output) {
+				return output.path;
+			}).should.deep.equal([
+				path.join('in', 'sub', 'a.png'),
+				path.join('in', 'sub', 'a-png8.png')
+			]);
+
+			options = batch.parseArgs(['-f', 'png8', 'in']);
+			batch.outputsFor(file, options)[0].path
+				.should.equal(path.join('in', 'sub', 'a.png'));
+		});
+
+		it('never overwrites the input', function() {
+			(function() {
+				batch.parseArgs(['-f', 'svg', 'in']);
+			}).should.throw(/output directory/);
+
+			var options = batch.parseArgs(['-o', 'in', '-f', 'svg', 'in']);
+			var input = { path: path.join('in', 'a.svg'), relative: 'a.svg' };
+			batch.overwritesInput(input, batch.outputsFor(input, options))
+				.should.be.true;
+		});
+	});
+
+	describe('command', function() {
+		this.timeout(20000);
+
+		it('renders and skips outputs that are up to date', function(done) {
+			write('a.svg');
+			write('sub/b.svg');
+			var args = [cli, '-j', '1', dir];
+
+			run(args, function(error, summary) {
+				if (error) {
+					return done(error);
+				}
+				summary.should.match(/^2 files, 2 outputs rendered/);
+				fs.existsSync(path.join(dir, 'sub', 'b.png')).should.be.true;
+
+				run(args, function(error, summary) {
+					if (error) {
+						return done(error);
+					}
+					summary.should.match(/, 2 up to date, 0 failed/);
+
+					run(args.concat('--force'), function(error, summary) {
+						summary.should.match(/2 outputs rendered.*, 0 up to date/);
+						done(error);
+					});
+				});
+			});
+		});
+
+		it('skips many up to date files in a small stack', function(done) {
+			for (var i = 0; i < 3000; i++) {
+				write(i + '.svg');
+				write(i + '.png', 'PNG');
+			}
+			var args = ['--stack-size=100', cli, '-j', '1', dir];
+
+			run(args, function(error, summary) {
+				summary.should.match(/, 3000 up to date, 0 failed/);
+				done(error);
+			});
+		});
+	});
+
+});
@@ -1,5 +1,6 @@
 'use strict';
 
+var os = require('os');
 var Writable = require('stream').Writable;
 var sinon = require('sinon');
 var Rsvg = require('..').Rsvg;
@@ -28,6 +29,13 @@ describe('Rsvg', function() {
 			onerror.lastCall.args[0].should.match(/write failure/i);
 		});
 
+		it('can be constructed with a byte array', function() {
+			var bytes = new Uint8Array(new Buffer('<svg width="6" height="9"></svg>'));
+			var svg = new Rsvg(bytes);
+			svg.width.should.equal(6);
+			svg.height.should.equal(9);
+		});
+
 		it('can be a writable stream', function() {
 			// Default constructor.
 			var svg = new Rsvg();
@@ -100,6 +108,179 @@ describe('Rsvg', function() {
 		});
 	});
 
+	describe('Rsvg.probe()', function() {
+		it('gives the size from the root element', function() {
+			Rsvg.probe('<svg width="314" height="257"/>').should.deep.equal({
+				width: 314,
+				height: 257,
+				viewBox: null,
+				widthUnit: '',
+				heightUnit: ''
+			});
+			var svg = new Buffer('<svg viewBox="0 0 40 30"><rect/></svg>');
+			Rsvg.probe(svg).should.deep.equal({
+				width: 40,
+				height: 30,
+				viewBox: { x: 0, y: 0, width: 40, height: 30 },
+				widthUnit: null,
+				heightUnit: null
+			});
+			svg = '<svg width="50%" height="15px" viewBox="1,2 40,30"/>';
+			Rsvg.probe(svg).should.deep.equal({
+				width: 20,
+				height: 15,
+				viewBox: { x: 1, y: 2, width: 40, height: 30 },
+				widthUnit: '%',
+				heightUnit: 'px'
+			});
+		});
+
+		it('matches the size of the parsed document', function() {
+			[
+				'<svg width="2in" height="3cm"><rect/></svg>',
+				'<svg width="20mm" height="14pt"><rect/></svg>',
+				'<svg width="2em" height="3pc"><rect/></svg>'
+			].forEach(function(svg) {
+				var probe = Rsvg.probe(svg);
+				probe.width.should.equal(new Rsvg(svg).width);
+				probe.height.should.equal(new Rsvg(svg).height);
+			});
+		});
+
+		it('gives an error for invalid SVG content', function() {
+			(function() {
+				Rsvg.probe('this is not a SVG file');
+			}).should.throw(/probe failure/i);
+		});
+	});
+
+	describe('Rsvg.compare()', function() {
+		function render(svg) {
+			return new Rsvg('<svg width="10" height="8">' + svg + '</svg>').render({
+				format: 'raw',
+				width: 10,
+				height: 8
+			});
+		}
+
+		it('finds no differences in equal images', function() {
+			var a = render('<rect width="5" height="4" fill="#f00"/>');
+			var b = render('<rect width="5" height="4" fill="#f00"/>');
+			Rsvg.compare(a, b).should.deep.equal({
+				mismatched: 0,
+				maxDelta: 0,
+				bounds: null
+			});
+		});
+
+		it('finds differences and their bounds', function() {
+			var a = render('<rect width="5" height="4" fill="#f00"/>');
+			var b = render('<rect width="5" height="4" fill="#f00"/>' +
+				'<rect x="6" y="2" width="2" height="3" fill="#0f0"/>' +
+				'<rect x="1" y="1" width="1" height="1" fill="#fe0000"/>');
+			var result = Rsvg.compare(a, b, { tolerance: 10, diff: true });
+			result.mismatched.should.equal(6);
+			result.maxDelta.should.equal(255);
+			result.bounds.should.deep.equal({ x: 6, y: 2, width: 2, height: 3 });
+			result.diff.width.should.equal(10);
+			result.diff.height.should.equal(8);
+			result.diff.data.length.should.equal(10 * 8 * 4);
+
+			Rsvg.compare(a, b).bounds.should.deep.equal({
+				x: 1, y: 1, width: 7, height: 4
+			});
+		});
+
+		it('compares unaligned image data', function() {
+			// Stored images are often slices of a larger buffer.
+			var pool = Buffer.alloc(1 + 2 * 3 * 4 + 2 + 2 * 3 * 4);
+			var a = { data: pool.slice(1, 25), width: 3, height: 2 };
+			var b = { data: pool.slice(27), width: 3, height: 2 };
+			b.data[4 * 4 + 1] = 0x80;
+			Rsvg.compare(a, b).should.deep.equal({
+				mismatched: 1,
+				maxDelta: 0x80,
+				bounds: { x: 1, y: 1, width: 1, height: 1 }
+			});
+		});
+
+		it('requires images of the same size', function() {
+			var a = render('');
+			var b = new Rsvg('<svg width="4" height="4"/>').render({
+				format: 'raw',
+				width: 4,
+				height: 4
+			});
+			(function() {
+				Rsvg.compare(a, b);
+			}).should.throw(RangeError);
+		});
+	});
+
+	describe('Rsvg.setLimits()', function() {
+		afterEach(function() {
+			Rsvg.setLimits({});
+		});
+
+		it('rejects renders above the limits', function() {
+			var svg = new Rsvg('<svg width="10" height="10"/>');
+			Rsvg.setLimits({ maxPixels: 10000, maxBytes: 100000 });
+			Rsvg.usage().should.deep.equal({
+				maxPixels: 10000,
+				maxBytes: 100000,
+				bytes: 0,
+				renders: 0
+			});
+
+			svg.render({ format: 'raw', width: 100, height: 100 })
+				.width.should.equal(100);
+			try {
+				svg.render({ format: 'raw', width: 101, height: 100 });
+				throw new Error('Expected error.');
+			} catch (error) {
+				error.should.be.an.instanceof(RangeError);
+				error.code.should.equal('ERR_RSVG_PIXEL_LIMIT');
+			}
+			try {
+				svg.render({ format: 'png', width: 100, height: 100 });
+				throw new Error('Expected error.');
+			} catch (error) {
+				error.should.be.an.instanceof(RangeError);
+				error.code.should.equal('ERR_RSVG_MEMORY_LIMIT');
+			}
+			svg.render({ format: 'pdf', width: 1000, height: 1000 })
+				.format.should.equal('pdf');
+			Rsvg.usage().bytes.should.equal(0);
+		});
+
+		it('counts the memory for quantizing palette images', function() {
+			var svg = new Rsvg('<svg width="10" height="10"/>');
+			Rsvg.setLimits({ maxBytes: 1000000 });
+
+			svg.render({ format: 'png', width: 100, height: 100 })
+				.format.should.equal('png');
+			try {
+				svg.render({ format: 'png8', width: 100, height: 100 });
+				throw new Error('Expected error.');
+			} catch (error) {
+				error.should.be.an.instanceof(RangeError);
+				error.code.should.equal('ERR_RSVG_MEMORY_LIMIT');
+			}
+			Rsvg.usage().bytes.should.equal(0);
+		});
+
+		it('rejects widths that cairo cannot allocate', function() {
+			var svg = new Rsvg('<svg width="10" height="10"/>');
+			try {
+				svg.render({ format: 'raw', width: 1 << 30, height: 1 });
+				throw new Error('Expected error.');
+			} catch (error) {
+				error.should.be.an.instanceof(RangeError);
+				error.code.should.equal('ERR_RSVG_PIXEL_LIMIT');
+			}
+		});
+	});
+
 	describe('baseURI', function() {
 		it('allows to reference external SVGs');
 	});
@@ -192,6 +373,55 @@ describe('Rsvg', function() {
 		});
 	});
 
+	describe('elements()', function() {
+		it('lists all elements with an ID', function() {
+			var svg = new Rsvg({ elements: true });
+			svg.write('<svg width="12" height="10">');
+			svg.write('<rect x="-2" y="3" width="7" height="5" id="r1"/>');
+			svg.write('<rect x="8" y="4" width="4" height="6" id="r2"/>');
+			svg.write('<circle cx="8" cy="3" r="3" id="circ"/>');
+			svg.write('</svg>');
+			svg.end();
+
+			svg.elements().should.deep.equal([
+				{ id: '#r1', type: 'rect', x: -2, y: 3, width: 7, height: 5 },
+				{ id: '#r2', type: 'rect', x: 8, y: 4, width: 4, height: 6 },
+				{ id: '#circ', type: 'circle', x: 5, y: 0, width: 6, height: 6 }
+			]);
+
+			// The cached list is shared, so nobody can change it.
+			var elements = svg.elements();
+			elements.should.equal(svg.elements());
+			Object.isFrozen(elements).should.be.true;
+			Object.isFrozen(elements[0]).should.be.true;
+			(function() {
+				elements.sort();
+			}).should.throw(TypeError);
+			(function() {
+				elements[0].width = 0;
+			}).should.throw(TypeError);
+
+			svg = new Rsvg('<svg width="3" height="3"></svg>', { elements: true });
+			svg.elements().should.deep.equal([]);
+		});
+
+		it('is only available with the elements option', function() {
+			var svg = new Rsvg('<svg width="3" height="3"></svg>');
+			(function() {
+				svg.elements();
+			}).should.throw(/elements option/);
+		});
+
+		it('updates the sizes when the DPI changes', function() {
+			var svg = new Rsvg('<svg width="1in" height="1in">' +
+				'<rect width="1in" height="1in" id="r"/></svg>', { elements: true });
+			svg.dpi = 90;
+			svg.elements()[0].width.should.equal(90);
+			svg.dpi = 180;
+			svg.elements()[0].width.should.equal(180);
+		});
+	});
+
 	describe('autocrop()', function() {
 		it('finds the drawing area of the SVG');
 	});
@@ -200,6 +430,95 @@ describe('Rsvg', function() {
 		it('does nothing for an empty SVG document');
 		it('renders as a raw memory buffer');
 		it('renders as a PNG image');
+		it('renders as a palette PNG image', function() {
+			var svg = new Rsvg('<svg width="40" height="30">' +
+				'<rect width="20" height="30" fill="#f80"/></svg>');
+			var png = svg.render({ format: 'png', width: 40, height: 30 });
+			var png8 = svg.render({ format: 'png8', width: 40, height: 30 });
+			png8.format.should.equal('png8');
+			png8.width.should.equal(40);
+			png8.height.should.equal(30);
+			png8.data.slice(1, 4).toString().should.equal('PNG');
+			png8.data.toString('binary').should.contain('PLTE');
+			png8.data.toString('binary').should.contain('tRNS');
+			png8.data.length.should.be.below(png.data.length);
+		});
+		it('can replay a recorded rendering', function() {
+			var svg = new Rsvg('<svg width="40" height="30">' +
+				'<circle cx="20" cy="15" r="10" fill="#08f" id="c"/></svg>');
+			[
+				{ format: 'raw', width: 40, height: 30 },
+				{ format: 'raw', width: 80, height: 60 },
+				{ format: 'raw', width: 16, height: 16, id: '#c' }
+			].forEach(function(options) {
+				var direct = svg.render(options);
+				options.record = true;
+				svg.render(options);
+				var replayed = svg.render(options);
+				Rsvg.compare(direct, replayed, { tolerance: 2 }).mismatched.should.equal(0);
+			});
+			svg.render({ format: 'pdf', width: 40, height: 30, record: true }).format
+				.should.equal('pdf');
+		});
+		it('records again when the DPI changes', function() {
+			var svg = new Rsvg('<svg width="100" height="100">' +
+				'<rect width="0.5in" height="100" fill="#f00"/></svg>');
+			var options = { format: 'raw', width: 100, height: 100, record: true };
+			svg.dpi = 90;
+			svg.render(options);
+			svg.dpi = 180;
+			var replayed = svg.render(options);
+			options.record = false;
+			Rsvg.compare(svg.render(options), replayed).mismatched.should.equal(0);
+		});
+		it('renders a draft preview in reduced resolution', function() {
+			// A one pixel wide line is crisp in full quality, and spread
+			// over its neighbours after scaling up a half resolution draft.
+			var svg = new Rsvg('<svg width="8" height="8">' +
+				'<rect x="3" width="1" height="8"/></svg>');
+			var size = { format: 'raw', width: 8, height: 8 };
+			var full = svg.render(size);
+			var draft = svg.render(Object.assign({ quality: 'draft' }, size));
+			var half = svg.render(Object.assign({
+				quality: 'draft',
+				resolution: 0.5
+			}, size));
+			// Raw pixels are 32 bit integers in native byte order.
+			var alpha = function(image, x, y) {
+				var offset = (y * image.width + x) * 4;
+				return image.data['readUInt32' + os.endianness()](offset) >>> 24;
+			};
+
+			alpha(full, 3, 0).should.equal(255);
+			alpha(full, 2, 0).should.equal(0);
+			alpha(draft, 3, 0).should.be.below(255);
+			alpha(draft, 2, 0).should.be.above(0);
+			draft.data.length.should.equal(full.data.length);
+			Rsvg.compare(draft, half).mismatched.should.equal(0);
+
+			(function() {
+				svg.render(Object.assign({
+					quality: 'draft',
+					resolution: 2
+				}, size));
+			}).should.throw(RangeError);
+
+			// The border of an opaque drawing stays opaque when scaling up.
+			var opaque = new Rsvg('<svg width="8" height="8">' +
+				'<rect width="8" height="8"/></svg>').render(
+				Object.assign({ quality: 'draft' }, size));
+			alpha(opaque, 0, 0).should.equal(255);
+			alpha(opaque, 7, 7).should.equal(255);
+		});
+		it('replays recordings in draft resolution', function() {
+			var svg = new Rsvg('<svg width="8" height="8">' +
+				'<rect x="3" width="1" height="8"/></svg>');
+			var options = { format: 'raw', width: 8, height: 8, quality: 'draft' };
+			var draft = svg.render(options);
+			options.record = true;
+			svg.render(options);
+			Rsvg.compare(svg.render(options), draft).mismatched.should.equal(0);
+		});
 		it('renders as a PDF document');
 		it('renders as a PDF document');
 		it('renders in various image sizes');
@@ -213,6 +532,47 @@ describe('Rsvg', function() {
 		it('can add a background color [future]');
 	});
 
+	describe('worker threads', function() {
+		var threads = null;
+		try {
+			threads = require('worker_threads');
+		} catch (error) {}
+
+		var source = [
+			'var threads = require("worker_threads");',
+			'var Rsvg = require(threads.workerData.module).Rsvg;',
+			'var svg = new Rsvg(threads.workerData.svg);',
+			'var image = svg.render({ format: "raw", width: 20, height: 10 });',
+			'threads.parentPort.postMessage(image.data.toString("base64"));'
+		].join('\n');
+
+		(threads ? it : it.skip)('loads and renders in each thread', function(done) {
+			this.timeout(10000);
+			var svg = '<svg width="2" height="1">' +
+				'<rect width="1" height="1" fill="red"/></svg>';
+			var expected = new Rsvg(svg).render({
+				format: 'raw', width: 20, height: 10
+			}).data.toString('base64');
+			var pending = 2;
+
+			function onMessage(data) {
+				data.should.equal(expected);
+				if (--pending === 0) {
+					done();
+				}
+			}
+
+			for (var i = 0; i < 2; i++) {
+				var worker = new threads.Worker(source, {
+					eval: true,
+					workerData: { module: require.resolve('..'), svg: svg }
+				});
+				worker.on('message', onMessage);
+				worker.on('error', done);
+			}
+		});
+	});
+
 	describe('toString()', function() {
 		it('gives a string representation', function() {
 			var svg = new Rsvg();